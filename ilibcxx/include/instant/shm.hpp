@@ -0,0 +1,61 @@
+#pragma once
+
+#include "syscall.hpp"
+
+namespace instant::shm {
+    constexpr int PROT_READ = 1;
+    constexpr int PROT_WRITE = 2;
+
+    // A named block of physical memory that any process can map. Mapping the
+    // same segment in two processes gives both of them the same frames, so
+    // whatever one writes the other sees without a copy.
+    struct Segment {
+        long id;
+        size_t size;
+
+        Segment() : id(-1), size(0) {}
+        Segment(long segment_id, size_t segment_size) : id(segment_id), size(segment_size) {}
+
+        bool is_valid() const {
+            return id >= 0;
+        }
+
+        void* map(int prot = PROT_READ | PROT_WRITE) const {
+            if (!is_valid()) return nullptr;
+
+            long result = sys::syscall2(sys::Syscall::SharedMemoryMap, id, static_cast<long>(prot));
+            if (result == -1) return nullptr;
+
+            return reinterpret_cast<void*>(result);
+        }
+
+        size_t get_size() const {
+            return size;
+        }
+    };
+
+    inline Segment create(const char* name, size_t size) {
+        long result = sys::syscall2(sys::Syscall::SharedMemoryCreate,
+                                    reinterpret_cast<long>(name), static_cast<long>(size));
+        if (result < 0) return Segment();
+
+        return Segment(result, (size + 4095) & ~static_cast<size_t>(4095));
+    }
+
+    inline Segment open(const char* name) {
+        unsigned long size = 0;
+        long result = sys::syscall2(sys::Syscall::SharedMemoryOpen,
+                                    reinterpret_cast<long>(name), reinterpret_cast<long>(&size));
+        if (result < 0) return Segment();
+
+        return Segment(result, size);
+    }
+
+    inline int unmap(void* addr) {
+        return static_cast<int>(sys::syscall1(sys::Syscall::SharedMemoryUnmap, reinterpret_cast<long>(addr)));
+    }
+
+    inline int unlink(const char* name) {
+        return static_cast<int>(sys::syscall1(sys::Syscall::SharedMemoryUnlink, reinterpret_cast<long>(name)));
+    }
+}
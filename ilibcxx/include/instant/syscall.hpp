@@ -11,6 +11,12 @@ struct OSInfo {
     uint64_t buildnum;
 };
 
+struct ExecStats {
+    uint64_t images;
+    uint64_t hits;
+    uint64_t misses;
+};
+
 extern "C" {
     long syscall0(long num);
     long syscall1(long num, long arg1);
@@ -50,6 +56,12 @@ namespace instant {
             FramebufferMapping,
             Signal,
             SignalReturn,
+            SharedMemoryCreate,
+            SharedMemoryOpen,
+            SharedMemoryMap,
+            SharedMemoryUnmap,
+            SharedMemoryUnlink,
+            ExecStats,
             CreateProcess = Fork,
             CloseProcess = Kill,
             WaitForProcess = Wait,
@@ -87,6 +99,12 @@ namespace instant {
         return info;
     }
 
+    inline ExecStats get_exec_stats() {
+        ExecStats stats = {};
+        sys::syscall1(sys::Syscall::ExecStats, reinterpret_cast<long>(&stats));
+        return stats;
+    }
+
     inline void exit(int status) {
         sys::syscall1(sys::Syscall::Exit, static_cast<long>(status));
     }
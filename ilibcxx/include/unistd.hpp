@@ -162,6 +162,16 @@ namespace std {
     }
     
     namespace memory {
+        constexpr int PROT_NONE = 0;
+        constexpr int PROT_READ = 1;
+        constexpr int PROT_WRITE = 2;
+        constexpr int PROT_EXEC = 4;
+
+        constexpr int MAP_PRIVATE = 0x02;
+        constexpr int MAP_ANONYMOUS = 0x20;
+
+        inline void* const MAP_FAILED = reinterpret_cast<void*>(-1);
+
         void* mmap(void* addr, size_t length, int prot, int flags, int fd, long offset);
         int munmap(void* addr, size_t length);
         
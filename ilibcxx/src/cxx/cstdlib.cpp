@@ -26,8 +26,7 @@ char* strcat(char* dest, const char* src) {
 }
 extern int __cxa_exitfunc(void(*func)());
 namespace std {
-    static char heap_space[1024 * 1024];
-    static size_t heap_offset = 0;
+    static constexpr size_t HEAP_SIZE = 16 * 1024 * 1024;
     static bool heap_initialized = false;
     
     struct heap_block {
@@ -38,14 +37,19 @@ namespace std {
     
     static heap_block* free_list = nullptr;
     
-    static void init_heap() {
+    static bool init_heap() {
         if (!heap_initialized) {
-            free_list = reinterpret_cast<heap_block*>(heap_space);
-            free_list->size = sizeof(heap_space) - sizeof(heap_block);
+            void* area = memory::mmap(nullptr, HEAP_SIZE, memory::PROT_READ | memory::PROT_WRITE,
+                                      memory::MAP_PRIVATE | memory::MAP_ANONYMOUS, -1, 0);
+            if (area == memory::MAP_FAILED) return false;
+
+            free_list = reinterpret_cast<heap_block*>(area);
+            free_list->size = HEAP_SIZE - sizeof(heap_block);
             free_list->free = true;
             free_list->next = nullptr;
             heap_initialized = true;
         }
+        return true;
     }
     
     [[noreturn]] void exit(int status) {
@@ -64,7 +68,7 @@ namespace std {
     void* malloc(size_t size) {
         if (size == 0) return nullptr;
         
-        init_heap();
+        if (!init_heap()) return nullptr;
         
         size = (size + 15) & ~15UL;
         
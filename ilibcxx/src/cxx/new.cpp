@@ -1,24 +1,31 @@
 #include <instant/syscall.hpp>
 #include <cstdio.hpp>
+#include <unistd.hpp>
 
 namespace {
-    constexpr unsigned long HEAP_START = 0x0000600000000000UL;
     constexpr unsigned long HEAP_SIZE = 16 * 1024 * 1024;
-    unsigned long heap_current = HEAP_START;
-    bool heap_initialized = false;
+    unsigned long heap_start = 0;
+    unsigned long heap_current = 0;
     
-    void init_heap() {
-        if (!heap_initialized) {
-            heap_initialized = true;
+    bool init_heap() {
+        if (!heap_start) {
+            void* area = std::memory::mmap(nullptr, HEAP_SIZE,
+                                           std::memory::PROT_READ | std::memory::PROT_WRITE,
+                                           std::memory::MAP_PRIVATE | std::memory::MAP_ANONYMOUS, -1, 0);
+            if (area == std::memory::MAP_FAILED) return false;
+
+            heap_start = reinterpret_cast<unsigned long>(area);
+            heap_current = heap_start;
         }
+        return true;
     }
     
     void* allocate(unsigned long size) {
-        init_heap();
+        if (!init_heap()) return nullptr;
         
         size = (size + 15) & ~15UL;
         
-        if (heap_current + size >= HEAP_START + HEAP_SIZE) {
+        if (heap_current + size >= heap_start + HEAP_SIZE) {
             return nullptr;
         }
         
@@ -53,7 +53,7 @@ void* uacpi_kernel_map(uacpi_phys_addr addr, uacpi_size len) {
         void* phys_ptr = reinterpret_cast<void*>(phys);
         void* virt_ptr = reinterpret_cast<void*>(phys + hhdm_request.response->offset);
         
-        vmm.map(virt_ptr, phys_ptr, PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE);
+        vmm.map(virt_ptr, phys_ptr, PTE_PRESENT | PTE_WRITABLE | VMM::typeFlags(MemoryType::Uncached));
     }
     
     return reinterpret_cast<void*>(addr + hhdm_request.response->offset);
@@ -47,7 +47,7 @@ bool LAPIC::initialize() {
     vmm.map(
         reinterpret_cast<void*>(lapic_virt),
         reinterpret_cast<void*>(lapic_phys),
-        PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE
+        PTE_PRESENT | PTE_WRITABLE | VMM::typeFlags(MemoryType::Uncached)
     );
     
     base = reinterpret_cast<volatile uint32_t*>(lapic_virt);
@@ -111,7 +111,7 @@ IOAPIC::IOAPIC(uint64_t physAddr, uint32_t gsiBase) : gsiBase(gsiBase) {
     vmm.map(
         reinterpret_cast<void*>(virt),
         reinterpret_cast<void*>(physAddr),
-        PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE
+        PTE_PRESENT | PTE_WRITABLE | VMM::typeFlags(MemoryType::Uncached)
     );
     
     base = reinterpret_cast<volatile uint32_t*>(virt);
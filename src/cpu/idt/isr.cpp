@@ -21,6 +21,17 @@ extern "C" void exceptionHandler(InterruptFrame* frame) {
         "Hypervisor Injection", "VMM Communication", "Security", "Reserved"
     };
 
+    if (frame->interrupt == 0x0E) {
+        uint64_t cr2;
+        asm volatile("mov %%cr2, %0" : "=r"(cr2));
+
+        Process* current = Scheduler::get().getCurrentProcess();
+        if (current && cr2 < VMM_KERNEL_HALF && current->getVMM()->isActive() &&
+            current->handlePageFault(cr2, frame->errCode)) {
+            return;
+        }
+    }
+
     if (frame->cs == 0x1B) {
         Process* current = Scheduler::get().getCurrentProcess();
 
@@ -1,81 +1,170 @@
 #include "bitmap.hpp"
 #include <string.h>
 
-Bitmap::Bitmap() : bmpBuffer(nullptr), bmpSize(0) {}
-Bitmap::Bitmap(uint8_t* buffer, size_t size) : bmpBuffer(nullptr), bmpSize(0) {
+constexpr size_t BITS_PER_WORD = 64;
+constexpr uint64_t FULL_WORD = ~0ULL;
+
+// -march=x86-64 has no popcnt and the kernel does not link libgcc
+static inline size_t popcount(uint64_t value) {
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (value * 0x0101010101010101ULL) >> 56;
+}
+
+static inline uint64_t rangeMask(size_t bit, size_t count) {
+    uint64_t mask = count >= BITS_PER_WORD ? FULL_WORD : ((1ULL << count) - 1);
+    return mask << bit;
+}
+
+Bitmap::Bitmap() : bmpWords(nullptr), bmpSize(0), wordCount(0), freeHint(0) {}
+Bitmap::Bitmap(uint8_t* buffer, size_t size) : bmpWords(nullptr), bmpSize(0), wordCount(0), freeHint(0) {
     init(buffer, size);
 }
 
 void Bitmap::init(uint8_t* buffer, size_t size) {
-    bmpBuffer = buffer;
+    bmpWords = reinterpret_cast<uint64_t*>(buffer);
     bmpSize = size;
+    wordCount = (size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    freeHint = 0;
 
-    memset(bmpBuffer, 0xFF, (size + 7) / 8);
+    memset(bmpWords, 0xFF, wordCount * sizeof(uint64_t));
 }
 
 bool Bitmap::set(size_t index) {
     if (index >= bmpSize) return false;
 
-    size_t byte = index / 8;
-    size_t bit = index % 8;
-    bmpBuffer[byte] |= (1 << bit);
+    bmpWords[index / BITS_PER_WORD] |= (1ULL << (index % BITS_PER_WORD));
     return true;
 }
 
 bool Bitmap::clear(size_t index) {
     if (index >= bmpSize) return false;
 
-    size_t byte = index / 8;
-    size_t bit = index % 8;
-    bmpBuffer[byte] &= ~(1 << bit);
+    bmpWords[index / BITS_PER_WORD] &= ~(1ULL << (index % BITS_PER_WORD));
+    lowerHint(index);
     return true;
 }
 
 bool Bitmap::get(size_t index) const {
     if (index >= bmpSize) return false;
 
-    size_t byte = index / 8;
-    size_t bit = index % 8;
-    return (bmpBuffer[byte] & (1 << bit)) != 0;
+    return (bmpWords[index / BITS_PER_WORD] & (1ULL << (index % BITS_PER_WORD))) != 0;
 }
 
-size_t Bitmap::findFirstFree() const {
-    for (size_t i = 0; i < bmpSize; i++) {
-        if (!get(i)) return i;
+size_t Bitmap::findNextClear(size_t start, size_t end) const {
+    if (end > bmpSize) end = bmpSize;
+    if (start >= end) return end;
+
+    size_t word = start / BITS_PER_WORD;
+    uint64_t bits = ~bmpWords[word] & (FULL_WORD << (start % BITS_PER_WORD));
+
+    while (!bits) {
+        word++;
+        if (word * BITS_PER_WORD >= end) return end;
+        bits = ~bmpWords[word];
     }
-    return bmpSize;
+
+    size_t index = word * BITS_PER_WORD + __builtin_ctzll(bits);
+    return index < end ? index : end;
+}
+
+size_t Bitmap::findNextSet(size_t start, size_t end) const {
+    if (end > bmpSize) end = bmpSize;
+    if (start >= end) return end;
+
+    size_t word = start / BITS_PER_WORD;
+    uint64_t bits = bmpWords[word] & (FULL_WORD << (start % BITS_PER_WORD));
+
+    while (!bits) {
+        word++;
+        if (word * BITS_PER_WORD >= end) return end;
+        bits = bmpWords[word];
+    }
+
+    size_t index = word * BITS_PER_WORD + __builtin_ctzll(bits);
+    return index < end ? index : end;
+}
+
+size_t Bitmap::countSet(size_t start, size_t count) const {
+    if (start >= bmpSize) return 0;
+    if (count > bmpSize - start) count = bmpSize - start;
+
+    size_t total = 0;
+    while (count) {
+        size_t bit = start % BITS_PER_WORD;
+        size_t chunk = BITS_PER_WORD - bit;
+        if (chunk > count) chunk = count;
+
+        total += popcount(bmpWords[start / BITS_PER_WORD] & rangeMask(bit, chunk));
+        start += chunk;
+        count -= chunk;
+    }
+    return total;
+}
+
+size_t Bitmap::findFirstFree() {
+    size_t index = findNextClear(freeHint * BITS_PER_WORD, bmpSize);
+    freeHint = index / BITS_PER_WORD;
+    return index;
 }
-    
-size_t Bitmap::findFirstFreeRegion(size_t count) const {
+
+size_t Bitmap::findFirstFreeRegion(size_t count) {
     if (count == 0) return bmpSize;
 
-    size_t consecutive = 0;
-    size_t start = 0;
-    
-    for (size_t i = 0; i < bmpSize; i++) {
-        if (!get(i)) {
-            if (consecutive == 0) start = i;
-            consecutive++;
+    size_t start = findNextClear(freeHint * BITS_PER_WORD, bmpSize);
+    freeHint = start / BITS_PER_WORD;
 
-            if (consecutive == count) return start;
-        } else {
-            consecutive = 0;
-        }
+    while (start < bmpSize && count <= bmpSize - start) {
+        size_t used = findNextSet(start, start + count);
+        if (used == start + count) return start;
+
+        start = findNextClear(used, bmpSize);
     }
 
     return bmpSize;
 }
-    
-bool Bitmap::setRange(size_t start, size_t count) {
-    for (size_t i = 0; i < count; i++) {
-        if (!set(start + i)) return false;
+
+void Bitmap::fillRange(size_t start, size_t count, bool value) {
+    while (count) {
+        size_t word = start / BITS_PER_WORD;
+        size_t bit = start % BITS_PER_WORD;
+
+        if (bit == 0 && count >= BITS_PER_WORD) {
+            size_t words = count / BITS_PER_WORD;
+            memset(&bmpWords[word], value ? 0xFF : 0x00, words * sizeof(uint64_t));
+            start += words * BITS_PER_WORD;
+            count -= words * BITS_PER_WORD;
+            continue;
+        }
+
+        size_t chunk = BITS_PER_WORD - bit;
+        if (chunk > count) chunk = count;
+
+        uint64_t mask = rangeMask(bit, chunk);
+        if (value) {
+            bmpWords[word] |= mask;
+        } else {
+            bmpWords[word] &= ~mask;
+        }
+
+        start += chunk;
+        count -= chunk;
     }
+}
+
+bool Bitmap::setRange(size_t start, size_t count) {
+    if (start > bmpSize || count > bmpSize - start) return false;
+
+    fillRange(start, count, true);
     return true;
 }
 
 bool Bitmap::clearRange(size_t start, size_t count) {
-    for (size_t i = 0; i < count; i++) {
-        if (!clear(start + i)) return false;
-    }
+    if (start > bmpSize || count > bmpSize - start) return false;
+    if (count == 0) return true;
+
+    fillRange(start, count, false);
+    lowerHint(start);
     return true;
-}
\ No newline at end of file
+}
@@ -10,18 +10,31 @@ public:
     void init(uint8_t* buffer, size_t size);
     bool get(size_t index) const;
     bool set(size_t index);
-    
+
     bool clear(size_t index);
-    
-    size_t findFirstFree() const;
-    size_t findFirstFreeRegion(size_t count) const;
-    
+
+    size_t findFirstFree();
+    size_t findFirstFreeRegion(size_t count);
+
+    size_t findNextClear(size_t start, size_t end) const;
+    size_t findNextSet(size_t start, size_t end) const;
+    size_t countSet(size_t start, size_t count) const;
+
     bool setRange(size_t start, size_t count);
     bool clearRange(size_t start, size_t count);
-    
+
     size_t size() const { return bmpSize; }
-    
+
+    static size_t storageSize(size_t bits) { return ((bits + 63) / 64) * sizeof(uint64_t); }
+
 private:
-    uint8_t* bmpBuffer;
+    uint64_t* bmpWords;
     size_t bmpSize;
+    size_t wordCount;
+    size_t freeHint;
+
+    void fillRange(size_t start, size_t count, bool value);
+    void lowerHint(size_t index) {
+        if (index / 64 < freeHint) freeHint = index / 64;
+    }
 };
@@ -0,0 +1,157 @@
+#include "buddy.hpp"
+
+void BuddyAllocator::init(Bitmap* bmp, uint64_t hhdmOffset, size_t first, size_t last) {
+    bitmap = bmp;
+    directMap = hhdmOffset;
+    firstPage = first;
+    lastPage = last;
+    freePages = 0;
+
+    for (size_t i = 0; i < BUDDY_MAX_ORDER; i++) {
+        freeLists[i] = nullptr;
+        freeBlocks[i] = 0;
+    }
+}
+
+bool BuddyAllocator::isFreeHead(size_t index, size_t order) const {
+    if (index < firstPage || index >= lastPage) return false;
+    if ((static_cast<size_t>(1) << order) > lastPage - index) return false;
+    if (bitmap->get(index)) return false;
+
+    BuddyBlock* block = blockAt(index);
+    return block->isValid() && block->order == order;
+}
+
+void BuddyAllocator::push(size_t index, size_t order) {
+    BuddyBlock* block = blockAt(index);
+    block->order = order;
+    block->magic = BuddyBlock::defaultMagic;
+    block->prev = nullptr;
+    block->next = freeLists[order];
+
+    if (freeLists[order]) {
+        freeLists[order]->prev = block;
+    }
+    freeLists[order] = block;
+
+    freeBlocks[order]++;
+    freePages += static_cast<size_t>(1) << order;
+}
+
+void BuddyAllocator::remove(size_t index, size_t order) {
+    BuddyBlock* block = blockAt(index);
+
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        freeLists[order] = block->next;
+    }
+
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+
+    block->magic = 0;
+
+    freeBlocks[order]--;
+    freePages -= static_cast<size_t>(1) << order;
+}
+
+size_t BuddyAllocator::allocate(size_t order) {
+    if (order >= BUDDY_MAX_ORDER) return INVALID_INDEX;
+
+    size_t current = order;
+    while (current < BUDDY_MAX_ORDER && !freeLists[current]) {
+        current++;
+    }
+    if (current == BUDDY_MAX_ORDER) return INVALID_INDEX;
+
+    size_t index = indexOf(freeLists[current]);
+    remove(index, current);
+
+    while (current > order) {
+        current--;
+        push(index + (static_cast<size_t>(1) << current), current);
+    }
+
+    bitmap->setRange(index, static_cast<size_t>(1) << order);
+    return index;
+}
+
+size_t BuddyAllocator::allocateExact(size_t count, size_t alignOrder) {
+    if (count == 0) return INVALID_INDEX;
+
+    size_t order = orderFor(count);
+    if (order < alignOrder) order = alignOrder;
+
+    size_t index = allocate(order);
+    if (index == INVALID_INDEX) return INVALID_INDEX;
+
+    size_t blockPages = static_cast<size_t>(1) << order;
+    if (blockPages > count) {
+        freeRange(index + count, blockPages - count);
+    }
+
+    return index;
+}
+
+void BuddyAllocator::free(size_t index, size_t order) {
+    bitmap->clearRange(index, static_cast<size_t>(1) << order);
+
+    while (order + 1 < BUDDY_MAX_ORDER) {
+        size_t buddy = index ^ (static_cast<size_t>(1) << order);
+        if (!isFreeHead(buddy, order)) break;
+
+        remove(buddy, order);
+        index = index < buddy ? index : buddy;
+        order++;
+    }
+
+    push(index, order);
+}
+
+void BuddyAllocator::freeRange(size_t index, size_t count) {
+    while (count) {
+        size_t order = 0;
+        while (order + 1 < BUDDY_MAX_ORDER &&
+               (index & ((static_cast<size_t>(2) << order) - 1)) == 0 &&
+               (static_cast<size_t>(2) << order) <= count) {
+            order++;
+        }
+
+        free(index, order);
+        index += static_cast<size_t>(1) << order;
+        count -= static_cast<size_t>(1) << order;
+    }
+}
+
+bool BuddyAllocator::claim(size_t index) {
+    // Interior pages of a free block keep whatever they held before, so a
+    // header found on them means nothing. Walking down from the largest
+    // candidate reaches the real head before any interior page.
+    size_t order = BUDDY_MAX_ORDER;
+    size_t head = index;
+
+    while (order > 0) {
+        order--;
+        head = index & ~((static_cast<size_t>(1) << order) - 1);
+        if (isFreeHead(head, order)) break;
+        if (order == 0) return false;
+    }
+
+    remove(head, order);
+
+    while (order > 0) {
+        order--;
+        size_t half = static_cast<size_t>(1) << order;
+        if (index < head + half) {
+            push(head + half, order);
+        } else {
+            push(head, order);
+            head += half;
+        }
+    }
+
+    bitmap->set(index);
+    return true;
+}
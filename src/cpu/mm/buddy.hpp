@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bitmap.hpp"
+#include "page.hpp"
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t BUDDY_MAX_ORDER = 20;
+
+struct BuddyBlock {
+    BuddyBlock* next;
+    BuddyBlock* prev;
+    uint64_t order;
+    uint64_t magic;
+
+    static constexpr uint64_t defaultMagic = 0x6275646479667265;
+
+    bool isValid() const {
+        return magic == defaultMagic;
+    }
+};
+
+class BuddyAllocator {
+public:
+    static constexpr size_t INVALID_INDEX = ~static_cast<size_t>(0);
+
+    BuddyAllocator() : bitmap(nullptr), directMap(0), firstPage(0), lastPage(0), freePages(0) {
+        for (size_t i = 0; i < BUDDY_MAX_ORDER; i++) {
+            freeLists[i] = nullptr;
+            freeBlocks[i] = 0;
+        }
+    }
+
+    void init(Bitmap* bmp, uint64_t hhdmOffset, size_t first, size_t last);
+
+    size_t allocate(size_t order);
+    size_t allocateExact(size_t count, size_t alignOrder);
+    void free(size_t index, size_t order);
+    void freeRange(size_t index, size_t count);
+    bool claim(size_t index);
+
+    size_t getFreeBlocks(size_t order) const { return order < BUDDY_MAX_ORDER ? freeBlocks[order] : 0; }
+    size_t getFreePages() const { return freePages; }
+
+    static size_t orderFor(size_t count) {
+        size_t order = 0;
+        while ((static_cast<size_t>(1) << order) < count) order++;
+        return order;
+    }
+
+private:
+    Bitmap* bitmap;
+    uint64_t directMap;
+    size_t firstPage;
+    size_t lastPage;
+    size_t freePages;
+
+    BuddyBlock* freeLists[BUDDY_MAX_ORDER];
+    size_t freeBlocks[BUDDY_MAX_ORDER];
+
+    BuddyBlock* blockAt(size_t index) const {
+        return reinterpret_cast<BuddyBlock*>(index * PAGE_SIZE + directMap);
+    }
+
+    size_t indexOf(BuddyBlock* block) const {
+        return (reinterpret_cast<uint64_t>(block) - directMap) / PAGE_SIZE;
+    }
+
+    bool isFreeHead(size_t index, size_t order) const;
+    void push(size_t index, size_t order);
+    void remove(size_t index, size_t order);
+};
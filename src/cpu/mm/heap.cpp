@@ -1,205 +1,433 @@
 #include "heap.hpp"
+#include <string.h>
 
 Heap kheap;
 
+static inline size_t fls(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
 void Heap::init(void* start, size_t size) {
     startLocation = start;
     endLocation = reinterpret_cast<void*>(reinterpret_cast<uint64_t>(start) + size);
     totalSize = size;
+    initialSize = size;
     usedSize = sizeof(HeapBlock);
-    
-    firstBlock = reinterpret_cast<HeapBlock*>(start);
-    firstBlock->size = size - sizeof(HeapBlock);
-    firstBlock->free = true;
-    firstBlock->next = nullptr;
-    firstBlock->prev = nullptr;
-    firstBlock->magic = HeapBlock::defaultMagic;
-    
+    trimThreshold = HEAP_DEFAULT_TRIM_THRESHOLD;
+    trimmedBytes = 0;
+
+    flBitmap = 0;
+    for (size_t fl = 0; fl < HEAP_FL_COUNT; fl++) {
+        slBitmap[fl] = 0;
+        for (size_t sl = 0; sl < HEAP_SL_COUNT; sl++) {
+            freeLists[fl][sl] = nullptr;
+        }
+    }
+
+    HeapBlock* block = reinterpret_cast<HeapBlock*>(start);
+    block->size = size - 2 * sizeof(HeapBlock);
+    block->prevPhys = nullptr;
+    block->magic = HeapBlock::defaultMagic;
+    block->free = true;
+
+    tail = block->nextPhys();
+    tail->size = 0;
+    tail->prevPhys = block;
+    tail->magic = HeapBlock::defaultMagic;
+    tail->free = false;
+
+    insertBlock(block);
+
+    slab.init();
+
     initialized = true;
 }
 
-HeapBlock* Heap::findFreeBlock(size_t size) {
-    HeapBlock* current = firstBlock;
-    
-    while (current) {
-        if (current->free && current->size >= size && current->isValid()) {
-            return current;
-        }
-        current = current->next;
+void Heap::mapping(size_t size, size_t& fl, size_t& sl) {
+    if (size < HEAP_SMALL_BLOCK) {
+        fl = 0;
+        sl = size >> HEAP_ALIGN_SHIFT;
+        return;
     }
-    
-    return nullptr;
+
+    size_t bit = fls(size);
+    sl = (size >> (bit - HEAP_SL_SHIFT)) ^ HEAP_SL_COUNT;
+    fl = bit - HEAP_FL_SHIFT + 1;
 }
 
-void Heap::splitBlock(HeapBlock* block, size_t size) {
-    if (block->size >= size + sizeof(HeapBlock) + 16) {
-        HeapBlock* newBlock = reinterpret_cast<HeapBlock*>(
-            reinterpret_cast<uint64_t>(block->getData()) + size
-        );
-        
-        newBlock->size = block->size - size - sizeof(HeapBlock);
-        newBlock->free = true;
-        newBlock->next = block->next;
-        newBlock->prev = block;
-        newBlock->magic = HeapBlock::defaultMagic;
-        
-        if (block->next) {
-            block->next->prev = newBlock;
-        }
-        
-        block->next = newBlock;
-        block->size = size;
+size_t Heap::roundForSearch(size_t size) {
+    if (size < HEAP_SMALL_BLOCK) return size;
+
+    size_t round = (static_cast<size_t>(1) << (fls(size) - HEAP_SL_SHIFT)) - 1;
+    return (size + round) & ~round;
+}
+
+void Heap::insertBlock(HeapBlock* block) {
+    size_t fl, sl;
+    mapping(block->size, fl, sl);
+
+    HeapBlock* head = freeLists[fl][sl];
+    block->prevFree = nullptr;
+    block->nextFree = head;
+    if (head) {
+        head->prevFree = block;
     }
+    freeLists[fl][sl] = block;
+
+    flBitmap |= 1ULL << fl;
+    slBitmap[fl] |= 1u << sl;
 }
 
-void Heap::mergeBlocks(HeapBlock* block) {
-    if (!block || !block->isValid()) return;
+void Heap::removeBlock(HeapBlock* block) {
+    size_t fl, sl;
+    mapping(block->size, fl, sl);
 
-    if (block->next && block->next->free && block->next->isValid()) {
-        block->size += sizeof(HeapBlock) + block->next->size;
-        block->next = block->next->next;
-        
-        if (block->next) {
-            block->next->prev = block;
-        }
+    if (block->prevFree) {
+        block->prevFree->nextFree = block->nextFree;
+    } else {
+        freeLists[fl][sl] = block->nextFree;
     }
 
-    if (block->prev && block->prev->free && block->prev->isValid()) {
-        block->prev->size += sizeof(HeapBlock) + block->size;
-        block->prev->next = block->next;
-        
-        if (block->next) {
-            block->next->prev = block->prev;
+    if (block->nextFree) {
+        block->nextFree->prevFree = block->prevFree;
+    }
+
+    if (!freeLists[fl][sl]) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl]) {
+            flBitmap &= ~(1ULL << fl);
         }
     }
 }
 
-void* Heap::allocate(size_t size) {
+HeapBlock* Heap::findSuitable(size_t size) {
+    size_t fl, sl;
+    mapping(roundForSearch(size), fl, sl);
+    if (fl >= HEAP_FL_COUNT) return nullptr;
+
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap = fl + 1 < HEAP_FL_COUNT ? flBitmap & (~0ULL << (fl + 1)) : 0;
+        if (!flMap) return nullptr;
+
+        fl = __builtin_ctzll(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = __builtin_ctz(slMap);
+
+    HeapBlock* block = freeLists[fl][sl];
+    removeBlock(block);
+    return block;
+}
+
+HeapBlock* Heap::mergeBlock(HeapBlock* block) {
+    HeapBlock* prev = block->prevPhys;
+    if (prev && prev->free && prev->isValid()) {
+        removeBlock(prev);
+        prev->size += sizeof(HeapBlock) + block->size;
+        block->magic = 0;
+        block = prev;
+        block->nextPhys()->prevPhys = block;
+    }
+
+    HeapBlock* next = block->nextPhys();
+    if (next->free && next->isValid()) {
+        removeBlock(next);
+        block->size += sizeof(HeapBlock) + next->size;
+        next->magic = 0;
+        block->nextPhys()->prevPhys = block;
+    }
+
+    return block;
+}
+
+void Heap::splitBlock(HeapBlock* block, size_t size) {
+    if (block->size < size + sizeof(HeapBlock) + 16) return;
+
+    HeapBlock* rest = reinterpret_cast<HeapBlock*>(
+        reinterpret_cast<uint64_t>(block->getData()) + size
+    );
+
+    rest->size = block->size - size - sizeof(HeapBlock);
+    rest->prevPhys = block;
+    rest->magic = HeapBlock::defaultMagic;
+    rest->free = true;
+    block->size = size;
+
+    rest->nextPhys()->prevPhys = rest;
+    insertBlock(rest);
+}
+
+HeapBlock* Heap::takeBlock(size_t size) {
+    HeapBlock* block = findSuitable(size);
+    if (block) return block;
+
+    if (!expand(roundForSearch(size) + sizeof(HeapBlock))) {
+        return nullptr;
+    }
+    return findSuitable(size);
+}
+
+void* Heap::allocate(size_t size, void* caller) {
+    void* ptr = allocateBlock(size);
+    profileAllocation(ptr, size, caller ? caller : __builtin_return_address(0));
+    return ptr;
+}
+
+void* Heap::allocateAligned(size_t size, size_t alignment, void* caller) {
+    void* ptr = allocateAlignedBlock(size, alignment);
+    profileAllocation(ptr, size, caller ? caller : __builtin_return_address(0));
+    return ptr;
+}
+
+void* Heap::allocateBlock(size_t size) {
     if (!initialized || size == 0) return nullptr;
 
+    if (size <= SLAB_MAX_SIZE) {
+        void* object = slab.allocate(size);
+        if (object) return object;
+    }
+
+    if (size >= HEAP_MAX_BLOCK) return nullptr;
     size = alignSize(size);
 
-    HeapBlock* block = findFreeBlock(size);
+    HeapBlock* block = takeBlock(size);
+    if (!block) return nullptr;
 
-    if (!block) {
-        if (!expand(size + sizeof(HeapBlock))) {
-            return nullptr;
-        }
-        block = findFreeBlock(size);
-        if (!block) return nullptr;
-    }
-    
     splitBlock(block, size);
-    
+
     block->free = false;
     usedSize += block->size + sizeof(HeapBlock);
-    
+
     return block->getData();
 }
 
-void* Heap::allocateAligned(size_t size, size_t alignment) {
+void* Heap::allocateAlignedBlock(size_t size, size_t alignment) {
     if (!initialized || size == 0) return nullptr;
-    
-    size_t total_size = size + alignment + sizeof(void*);
-    void* ptr = allocate(total_size);
-    
-    if (!ptr) return nullptr;
-    
-    uint64_t addr = reinterpret_cast<uint64_t>(ptr);
-    uint64_t aligned = (addr + sizeof(void*) + alignment - 1) & ~(alignment - 1);
-    
-    void** original_ptr = reinterpret_cast<void**>(aligned - sizeof(void*));
-    *original_ptr = ptr;
-    
-    return reinterpret_cast<void*>(aligned);
+    if (alignment & (alignment - 1)) return nullptr;
+
+    if (alignment <= 16) {
+        return allocateBlock(size);
+    }
+
+    size_t objectSize = size > alignment ? size : alignment;
+    if (objectSize <= SLAB_MAX_SIZE) {
+        void* object = slab.allocate(objectSize);
+        if (object) return object;
+    }
+
+    if (size >= HEAP_MAX_BLOCK || alignment >= HEAP_MAX_BLOCK) return nullptr;
+    size = alignSize(size);
+
+    size_t minFragment = sizeof(HeapBlock) + 16;
+    HeapBlock* block = takeBlock(size + alignment + minFragment);
+    if (!block) return nullptr;
+
+    uint64_t data = reinterpret_cast<uint64_t>(block->getData());
+    uint64_t aligned = (data + alignment - 1) & ~(alignment - 1);
+    if (aligned != data && aligned - data < minFragment) {
+        aligned = (data + minFragment + alignment - 1) & ~(alignment - 1);
+    }
+
+    if (aligned != data) {
+        size_t gap = aligned - data;
+        HeapBlock* alignedBlock = HeapBlock::fromData(reinterpret_cast<void*>(aligned));
+
+        alignedBlock->size = block->size - gap;
+        alignedBlock->prevPhys = block;
+        alignedBlock->magic = HeapBlock::defaultMagic;
+        alignedBlock->nextPhys()->prevPhys = alignedBlock;
+
+        block->size = gap - sizeof(HeapBlock);
+        insertBlock(block);
+
+        block = alignedBlock;
+    }
+
+    splitBlock(block, size);
+
+    block->free = false;
+    usedSize += block->size + sizeof(HeapBlock);
+
+    return block->getData();
 }
 
 void Heap::free(void* ptr) {
     if (!initialized || !ptr) return;
-    
+
+    profileFree(ptr);
+
+    if (!ownsBlock(ptr)) {
+        slab.free(ptr);
+        return;
+    }
+
     HeapBlock* block = HeapBlock::fromData(ptr);
-    
+
     if (!block->isValid() || block->free) {
         return;
     }
-    
+
     block->free = true;
     usedSize -= block->size + sizeof(HeapBlock);
-    
-    mergeBlocks(block);
+
+    insertBlock(mergeBlock(block));
+
+    // Keep half the threshold mapped so a workload hovering around it does
+    // not unmap and remap the tail on every allocate/free cycle.
+    if (getFreeSize() > trimThreshold) {
+        trim(trimThreshold / 2);
+    }
 }
 
-void* Heap::reallocate(void* ptr, size_t newSize) {
+void* Heap::reallocate(void* ptr, size_t newSize, void* caller) {
+    if (!caller) {
+        caller = __builtin_return_address(0);
+    }
+
     if (!ptr) {
-        return allocate(newSize);
+        return allocate(newSize, caller);
     }
-    
+
     if (newSize == 0) {
         free(ptr);
         return nullptr;
     }
-    
-    HeapBlock* block = HeapBlock::fromData(ptr);
-    
-    if (!block->isValid()) {
-        return nullptr;
-    }
-    
-    newSize = alignSize(newSize);
-    if (block->size >= newSize) {
-        return ptr;
+
+    size_t oldSize;
+    if (ownsBlock(ptr)) {
+        HeapBlock* block = HeapBlock::fromData(ptr);
+
+        if (!block->isValid() || block->free) {
+            return nullptr;
+        }
+        if (newSize >= HEAP_MAX_BLOCK) {
+            return nullptr;
+        }
+        if (resizeBlock(block, alignSize(newSize))) {
+            profileFree(ptr);
+            profileAllocation(ptr, newSize, caller);
+            return ptr;
+        }
+        oldSize = block->size;
+    } else {
+        oldSize = slab.objectSize(ptr);
+        if (oldSize == 0) {
+            return nullptr;
+        }
+        if (oldSize >= newSize) {
+            profileFree(ptr);
+            profileAllocation(ptr, newSize, caller);
+            return ptr;
+        }
     }
-    
-    void* pointer = allocate(newSize);
+
+    void* pointer = allocate(newSize, caller);
     if (!pointer) {
         return nullptr;
     }
-    
-    size_t copy_size = block->size < newSize ? block->size : newSize;
-    uint8_t* src = reinterpret_cast<uint8_t*>(ptr);
-    uint8_t* dst = reinterpret_cast<uint8_t*>(pointer);
-    
-    for (size_t i = 0; i < copy_size; i++) {
-        dst[i] = src[i];
-    }
-    
+
+    memcpy(pointer, ptr, oldSize < newSize ? oldSize : newSize);
     free(ptr);
-    
+
     return pointer;
 }
 
+bool Heap::resizeBlock(HeapBlock* block, size_t size) {
+    if (block->size < size) {
+        HeapBlock* next = block->nextPhys();
+        if (next == tail && !expand(size - block->size)) {
+            return false;
+        }
+
+        next = block->nextPhys();
+        if (!next->free || !next->isValid()) return false;
+        if (block->size + sizeof(HeapBlock) + next->size < size) return false;
+
+        removeBlock(next);
+        usedSize += sizeof(HeapBlock) + next->size;
+        block->size += sizeof(HeapBlock) + next->size;
+        next->magic = 0;
+        block->nextPhys()->prevPhys = block;
+    }
+
+    size_t oldSize = block->size;
+    splitBlock(block, size);
+
+    if (block->size != oldSize) {
+        HeapBlock* rest = block->nextPhys();
+        usedSize -= oldSize - block->size;
+
+        removeBlock(rest);
+        insertBlock(mergeBlock(rest));
+    }
+
+    return true;
+}
+
 bool Heap::expand(size_t finalSize) {
     size_t _pages = (finalSize + PAGE_SIZE - 1) / PAGE_SIZE;
-    
+
     void* phys = pmm.allocatePages(_pages);
     if (!phys) {
         return false;
     }
-    
+
     void* virt = endLocation;
-    if (!vmm.mapRange(virt, phys, _pages, PTE_PRESENT | PTE_WRITABLE)) {
+    if (!vmm.mapRange(virt, phys, _pages, PTE_PRESENT | PTE_WRITABLE | PTE_OWNED)) {
         pmm.freePages(phys, _pages);
         return false;
     }
-    
-    HeapBlock* newBlock = reinterpret_cast<HeapBlock*>(endLocation);
-    newBlock->size = _pages * PAGE_SIZE - sizeof(HeapBlock);
-    newBlock->free = true;
-    newBlock->next = nullptr;
-    newBlock->magic = HeapBlock::defaultMagic;
-    
-    HeapBlock* last = firstBlock;
-    while (last->next) {
-        last = last->next;
-    }
 
-    last->next = newBlock;
-    newBlock->prev = last;
+    HeapBlock* block = tail;
+    block->size = _pages * PAGE_SIZE - sizeof(HeapBlock);
+    block->free = true;
+
+    tail = block->nextPhys();
+    tail->size = 0;
+    tail->prevPhys = block;
+    tail->magic = HeapBlock::defaultMagic;
+    tail->free = false;
 
     endLocation = reinterpret_cast<void*>(reinterpret_cast<uint64_t>(endLocation) + _pages * PAGE_SIZE);
     totalSize += _pages * PAGE_SIZE;
 
-    mergeBlocks(newBlock);
-    
+    insertBlock(mergeBlock(block));
+
     return true;
-}
\ No newline at end of file
+}
+
+size_t Heap::trim(size_t slack) {
+    if (!initialized) return 0;
+
+    HeapBlock* block = tail->prevPhys;
+    if (!block || !block->free) return 0;
+
+    uint64_t keep = reinterpret_cast<uint64_t>(block->getData()) + 16 + sizeof(HeapBlock) + slack;
+    uint64_t newEnd = (keep + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint64_t minEnd = reinterpret_cast<uint64_t>(startLocation) + initialSize;
+    uint64_t oldEnd = reinterpret_cast<uint64_t>(endLocation);
+
+    if (newEnd < minEnd) newEnd = minEnd;
+    if (newEnd >= oldEnd) return 0;
+
+    removeBlock(block);
+
+    tail = reinterpret_cast<HeapBlock*>(newEnd - sizeof(HeapBlock));
+    tail->size = 0;
+    tail->prevPhys = block;
+    tail->magic = HeapBlock::defaultMagic;
+    tail->free = false;
+
+    block->size = reinterpret_cast<uint64_t>(tail) - reinterpret_cast<uint64_t>(block->getData());
+    insertBlock(block);
+
+    vmm.freeRange(reinterpret_cast<void*>(newEnd), (oldEnd - newEnd) / PAGE_SIZE);
+
+    size_t released = oldEnd - newEnd;
+    endLocation = reinterpret_cast<void*>(newEnd);
+    totalSize -= released;
+    trimmedBytes += released;
+
+    return released;
+}
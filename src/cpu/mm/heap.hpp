@@ -1,27 +1,44 @@
 #pragma once
 
+#include "heapprof.hpp"
 #include "pmm.hpp"
+#include "slab.hpp"
 #include "vmm.hpp"
 #include <cstdint>
 #include <cstddef>
 
-struct HeapBlock {
+constexpr size_t HEAP_ALIGN_SHIFT = 4;
+constexpr size_t HEAP_SL_SHIFT = 4;
+constexpr size_t HEAP_SL_COUNT = static_cast<size_t>(1) << HEAP_SL_SHIFT;
+constexpr size_t HEAP_FL_SHIFT = HEAP_SL_SHIFT + HEAP_ALIGN_SHIFT;
+constexpr size_t HEAP_FL_MAX = 39;
+constexpr size_t HEAP_FL_COUNT = HEAP_FL_MAX - HEAP_FL_SHIFT + 1;
+constexpr size_t HEAP_SMALL_BLOCK = static_cast<size_t>(1) << HEAP_FL_SHIFT;
+constexpr size_t HEAP_MAX_BLOCK = static_cast<size_t>(1) << HEAP_FL_MAX;
+constexpr size_t HEAP_DEFAULT_TRIM_THRESHOLD = 512 * 1024;
+
+struct alignas(16) HeapBlock {
     size_t size;
-    bool free;
-    HeapBlock* next;
-    HeapBlock* prev;
+    HeapBlock* prevPhys;
+    HeapBlock* nextFree;
+    HeapBlock* prevFree;
     uint32_t magic;
-    
+    bool free;
+
     static constexpr uint32_t defaultMagic = 0x1248ace0;
-    
+
     void* getData() {
         return reinterpret_cast<void*>(reinterpret_cast<uint64_t>(this) + sizeof(HeapBlock));
     }
-    
+
     static HeapBlock* fromData(void* data) {
         return reinterpret_cast<HeapBlock*>(reinterpret_cast<uint64_t>(data) - sizeof(HeapBlock));
     }
-    
+
+    HeapBlock* nextPhys() {
+        return reinterpret_cast<HeapBlock*>(reinterpret_cast<uint64_t>(getData()) + size);
+    }
+
     bool isValid() const {
         return magic == defaultMagic;
     }
@@ -29,41 +46,83 @@ struct HeapBlock {
 
 class Heap {
 public:
-    Heap() : startLocation(nullptr), endLocation(nullptr), firstBlock(nullptr), 
-             initialized(false), totalSize(0), usedSize(0) {}
-    
+    Heap() : startLocation(nullptr), endLocation(nullptr), tail(nullptr),
+             initialized(false), totalSize(0), usedSize(0), initialSize(0),
+             trimThreshold(HEAP_DEFAULT_TRIM_THRESHOLD), trimmedBytes(0), flBitmap(0) {}
+
 
     void init(void* start, size_t size);
 
-    void* allocate(size_t size);
-    void* allocateAligned(size_t size, size_t alignment);
+    void* allocate(size_t size, void* caller = nullptr);
+    void* allocateAligned(size_t size, size_t alignment, void* caller = nullptr);
     void free(void* ptr);
-    void* reallocate(void* ptr, size_t newSize);
+    void* reallocate(void* ptr, size_t newSize, void* caller = nullptr);
 
 
     size_t getTotalSize() const { return totalSize; }
     size_t getUsedSize() const { return usedSize; }
     size_t getFreeSize() const { return totalSize - usedSize; }
-    
+    uint64_t getTrimmedBytes() const { return trimmedBytes; }
+
+    void setTrimThreshold(size_t bytes) { trimThreshold = bytes; }
+    size_t getTrimThreshold() const { return trimThreshold; }
+
+    const SlabAllocator& getSlab() const { return slab; }
+
     bool isInitialized() const { return initialized; }
-    
+
     bool expand(size_t finalSize);
-    
+    size_t trim(size_t slack = 0);
+
 private:
     void* startLocation;
     void* endLocation;
-    HeapBlock* firstBlock;
+    HeapBlock* tail;
     bool initialized;
     size_t totalSize;
     size_t usedSize;
+    size_t initialSize;
+    size_t trimThreshold;
+    uint64_t trimmedBytes;
+    SlabAllocator slab;
+
+    uint64_t flBitmap;
+    uint32_t slBitmap[HEAP_FL_COUNT];
+    HeapBlock* freeLists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+
+    bool ownsBlock(void* ptr) const {
+        return ptr >= startLocation && ptr < endLocation;
+    }
 
-    HeapBlock* findFreeBlock(size_t size);
+    static void mapping(size_t size, size_t& fl, size_t& sl);
+    static size_t roundForSearch(size_t size);
+
+    void insertBlock(HeapBlock* block);
+    void removeBlock(HeapBlock* block);
+    HeapBlock* findSuitable(size_t size);
+    HeapBlock* takeBlock(size_t size);
+    void* allocateBlock(size_t size);
+    void* allocateAlignedBlock(size_t size, size_t alignment);
+    HeapBlock* mergeBlock(HeapBlock* block);
     void splitBlock(HeapBlock* block, size_t size);
-    void mergeBlocks(HeapBlock* block);
-    
+    bool resizeBlock(HeapBlock* block, size_t size);
+
+    static void profileAllocation([[maybe_unused]] void* ptr, [[maybe_unused]] size_t size,
+                                  [[maybe_unused]] void* caller) {
+#ifdef KHEAP_PROFILE
+        if (ptr) heapProfiler.recordAllocation(ptr, size, caller);
+#endif
+    }
+
+    static void profileFree([[maybe_unused]] void* ptr) {
+#ifdef KHEAP_PROFILE
+        heapProfiler.recordFree(ptr);
+#endif
+    }
+
     static size_t alignSize(size_t size) {
         return (size + 15) & ~15;
     }
 };
 
-extern Heap kheap;
\ No newline at end of file
+extern Heap kheap;
@@ -0,0 +1,205 @@
+#include "heapprof.hpp"
+
+#ifdef KHEAP_PROFILE
+
+#include <cpu/process/scheduler.hpp>
+#include <graphics/console.hpp>
+#include <x86_64/ports.hpp>
+
+extern Console* console;
+
+HeapProfiler heapProfiler;
+
+static uint8_t sizeClassOf(size_t size) {
+    return size ? 63 - __builtin_clzll(size) : 0;
+}
+
+HeapSite* HeapProfiler::findSite(uint64_t caller, bool create) {
+    size_t slot = hash(caller, HEAP_PROFILE_SITES);
+
+    for (size_t i = 0; i < HEAP_PROFILE_SITES; i++) {
+        HeapSite* site = &sites[(slot + i) & (HEAP_PROFILE_SITES - 1)];
+        if (site->caller == caller) return site;
+
+        if (site->caller == 0) {
+            if (!create) return nullptr;
+
+            site->caller = caller;
+            return site;
+        }
+    }
+
+    return nullptr;
+}
+
+void HeapProfiler::recordAllocation(void* ptr, size_t size, void* caller) {
+    uint64_t address = reinterpret_cast<uint64_t>(ptr);
+    uint64_t callerAddress = reinterpret_cast<uint64_t>(caller);
+    uint8_t sizeClass = sizeClassOf(size);
+
+    HeapSite* site = findSite(callerAddress, true);
+    if (site) {
+        site->allocations++;
+        site->totalBytes += size;
+        site->classMask |= 1u << (sizeClass & 31);
+    }
+
+    if (!site || recordCount >= HEAP_PROFILE_RECORDS * 3 / 4) {
+        dropped++;
+        return;
+    }
+
+    Process* current = Scheduler::get().getCurrentProcess();
+
+    size_t slot = hash(address, HEAP_PROFILE_RECORDS);
+    while (records[slot].address && records[slot].address != address) {
+        slot = (slot + 1) & (HEAP_PROFILE_RECORDS - 1);
+    }
+    if (!records[slot].address) {
+        recordCount++;
+    }
+
+    HeapRecord& record = records[slot];
+    record.address = address;
+    record.caller = callerAddress;
+    record.timestamp = rdtsc();
+    record.size = static_cast<uint32_t>(size);
+    record.pid = current ? static_cast<uint16_t>(current->getPID()) : 0;
+    record.sizeClass = sizeClass;
+
+    site->liveObjects++;
+    site->liveBytes += size;
+}
+
+void HeapProfiler::recordFree(void* ptr) {
+    uint64_t address = reinterpret_cast<uint64_t>(ptr);
+
+    size_t slot = hash(address, HEAP_PROFILE_RECORDS);
+    while (records[slot].address != address) {
+        if (!records[slot].address) return;
+        slot = (slot + 1) & (HEAP_PROFILE_RECORDS - 1);
+    }
+
+    HeapSite* site = findSite(records[slot].caller, false);
+    if (site) {
+        site->frees++;
+        site->liveObjects--;
+        site->liveBytes -= records[slot].size;
+    }
+
+    size_t hole = slot;
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & (HEAP_PROFILE_RECORDS - 1);
+        if (!records[next].address) break;
+
+        size_t home = hash(records[next].address, HEAP_PROFILE_RECORDS);
+        bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable) {
+            records[hole] = records[next];
+            hole = next;
+        }
+    }
+
+    records[hole].address = 0;
+    recordCount--;
+}
+
+void HeapProfiler::dumpBy(bool byBytes, size_t count) {
+    HeapSite* printed[32];
+    if (count > 32) count = 32;
+
+    for (size_t n = 0; n < count; n++) {
+        HeapSite* best = nullptr;
+
+        for (size_t i = 0; i < HEAP_PROFILE_SITES; i++) {
+            HeapSite* site = &sites[i];
+            if (!site->caller) continue;
+
+            bool seen = false;
+            for (size_t j = 0; j < n; j++) {
+                if (printed[j] == site) seen = true;
+            }
+            if (seen) continue;
+
+            uint64_t value = byBytes ? site->totalBytes : site->allocations;
+            if (!best || value > (byBytes ? best->totalBytes : best->allocations)) {
+                best = site;
+            }
+        }
+
+        if (!best) break;
+        printed[n] = best;
+
+        console->drawText("  0x");
+        console->drawHex(best->caller);
+        console->drawText(" allocs=");
+        console->drawNumber(best->allocations);
+        console->drawText(" bytes=");
+        console->drawNumber(best->totalBytes);
+        console->drawText(" live=");
+        console->drawNumber(best->liveObjects);
+        console->drawText("/");
+        console->drawNumber(best->liveBytes);
+        console->drawText(" classes=0x");
+        console->drawHex(best->classMask);
+        console->drawText("\n");
+    }
+}
+
+void HeapProfiler::dump(size_t count) {
+    if (!console) return;
+
+    console->drawText("[KHEAP] Top sites by bytes:\n");
+    dumpBy(true, count);
+    console->drawText("[KHEAP] Top sites by count:\n");
+    dumpBy(false, count);
+
+    console->drawText("[KHEAP] Tracked=");
+    console->drawNumber(recordCount);
+    console->drawText(" dropped=");
+    console->drawNumber(dropped);
+    console->drawText("\n");
+}
+
+void HeapProfiler::reportLeaks(uint32_t pid) {
+    if (!console || pid == 0) return;
+
+    uint64_t now = rdtsc();
+    size_t leaks = 0;
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < HEAP_PROFILE_RECORDS; i++) {
+        HeapRecord& record = records[i];
+        if (!record.address || record.pid != static_cast<uint16_t>(pid)) continue;
+
+        if (leaks < 16) {
+            console->drawText("[KHEAP] PID=");
+            console->drawNumber(pid);
+            console->drawText(" leaked ");
+            console->drawNumber(record.size);
+            console->drawText(" bytes at 0x");
+            console->drawHex(record.address);
+            console->drawText(" from 0x");
+            console->drawHex(record.caller);
+            console->drawText(" age=");
+            console->drawNumber(now - record.timestamp);
+            console->drawText(" cycles\n");
+        }
+
+        leaks++;
+        bytes += record.size;
+    }
+
+    if (leaks) {
+        console->drawText("[KHEAP] PID=");
+        console->drawNumber(pid);
+        console->drawText(" exited with ");
+        console->drawNumber(leaks);
+        console->drawText(" live allocations (");
+        console->drawNumber(bytes);
+        console->drawText(" bytes)\n");
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t HEAP_PROFILE_RECORDS = 8192;
+constexpr size_t HEAP_PROFILE_SITES = 512;
+constexpr size_t HEAP_PROFILE_DUMP_SITES = 10;
+
+struct HeapRecord {
+    uint64_t address;
+    uint64_t caller;
+    uint64_t timestamp;
+    uint32_t size;
+    uint16_t pid;
+    uint8_t sizeClass;
+};
+
+struct HeapSite {
+    uint64_t caller;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t totalBytes;
+    uint64_t liveObjects;
+    uint64_t liveBytes;
+    uint32_t classMask;
+};
+
+class HeapProfiler {
+public:
+    void recordAllocation(void* ptr, size_t size, void* caller);
+    void recordFree(void* ptr);
+
+    void dump(size_t count);
+    void reportLeaks(uint32_t pid);
+
+    uint64_t getDropped() const { return dropped; }
+
+private:
+    HeapRecord records[HEAP_PROFILE_RECORDS];
+    HeapSite sites[HEAP_PROFILE_SITES];
+    size_t recordCount;
+    uint64_t dropped;
+
+    HeapSite* findSite(uint64_t caller, bool create);
+    void dumpBy(bool byBytes, size_t count);
+
+    static size_t hash(uint64_t value, size_t slots) {
+        return ((value >> 4) * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctzll(slots));
+    }
+};
+
+extern HeapProfiler heapProfiler;
@@ -2,11 +2,11 @@
 #include <cstddef>
 
 void* operator new(size_t size) {
-    return kheap.allocate(size);
+    return kheap.allocate(size, __builtin_return_address(0));
 }
 
 void* operator new[](size_t size) {
-    return kheap.allocate(size);
+    return kheap.allocate(size, __builtin_return_address(0));
 }
 
 void* operator new(size_t, void* ptr) noexcept {
@@ -18,11 +18,11 @@ void* operator new[](size_t, void* ptr) noexcept {
 }
 
 void* operator new(size_t size, std::align_val_t align) {
-    return kheap.allocateAligned(size, static_cast<size_t>(align));
+    return kheap.allocateAligned(size, static_cast<size_t>(align), __builtin_return_address(0));
 }
 
 void* operator new[](size_t size, std::align_val_t align) {
-    return kheap.allocateAligned(size, static_cast<size_t>(align));
+    return kheap.allocateAligned(size, static_cast<size_t>(align), __builtin_return_address(0));
 }
 
 void operator delete(void* ptr) noexcept {
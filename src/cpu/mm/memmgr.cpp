@@ -3,8 +3,7 @@
 #include "heap.hpp"
 #include "memmgr.hpp"
 #include <x86_64/requests.hpp>
-
-static uint8_t PMMBMP[1024 * 1024] __attribute__((aligned(4096)));
+#include <x86_64/ports.hpp>
 
 MemoryManager::MemoryManager(){
     limine_memmap_response* memmap = memorymap_request.response;
@@ -22,26 +21,59 @@ MemoryManager::MemoryManager(){
         if (entry->type == LIMINE_MEMMAP_USABLE ||
             entry->type == LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE) {
             totalMemory += entry->length;
+
+            if (entry->base + entry->length > managedTop) {
+                managedTop = entry->base + entry->length;
+            }
         }
     }
 
-    pmm.init(PMMBMP, highestAddress);
+    uint64_t pmmStart = rdtsc();
+
+    size_t bitmapBytes = PMM::storageSize(managedTop);
+    bitmapBytes = (bitmapBytes + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    uint64_t bitmapBase = 0;
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+
+        uint64_t base = (entry->base + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        uint64_t end = (entry->base + entry->length) & ~(PAGE_SIZE - 1);
+        if (base == 0) base = PAGE_SIZE;
+        if (end > base && end - base >= bitmapBytes) {
+            bitmapBase = base;
+            break;
+        }
+    }
+
+    if (!bitmapBase) {
+        return;
+    }
+
+    uint8_t* bitmap = reinterpret_cast<uint8_t*>(bitmapBase + hhdm_request.response->offset);
+    pmm.init(bitmap, managedTop);
 
     for (uint64_t i = 0; i < memmap->entry_count; i++) {
         struct limine_memmap_entry* entry = memmap->entries[i];
         
-        if (entry->type == LIMINE_MEMMAP_USABLE) {
-            uint64_t start_addr = entry->base;
-            uint64_t end_addr = entry->base + entry->length;
-            
-            for (uint64_t addr = start_addr; addr < end_addr; addr += PAGE_SIZE) {
-                pmm.freePage(reinterpret_cast<void*>(addr));
-            }
+        if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+
+        uint64_t end = entry->base + entry->length;
+        if (bitmapBase >= entry->base && bitmapBase < end) {
+            pmm.freeRegion(entry->base, bitmapBase - entry->base);
+            pmm.freeRegion(bitmapBase + bitmapBytes, end - (bitmapBase + bitmapBytes));
+        } else {
+            pmm.freeRegion(entry->base, entry->length);
         }
     }
+
+    pmmInitCycles = rdtsc() - pmmStart;
     
     PageTable* pageTable = VMM::getCurrentPageTable();
     vmm.init(pageTable);
+    VMM::setupTLB();
+    VMM::setupPAT();
     for (uint64_t i = 0; i < memmap->entry_count; i++) {
         struct limine_memmap_entry* entry = memmap->entries[i];
         
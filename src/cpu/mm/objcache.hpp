@@ -0,0 +1,69 @@
+#pragma once
+
+#include "pmm.hpp"
+#include <x86_64/requests.hpp>
+#include <cstdint>
+#include <cstddef>
+
+template <typename T, size_t ChunkPages = 1>
+class ObjectCache {
+public:
+    static constexpr size_t OBJECT_ALIGN = alignof(T) > 16 ? alignof(T) : 16;
+    static constexpr size_t OBJECT_SIZE = (sizeof(T) + OBJECT_ALIGN - 1) & ~(OBJECT_ALIGN - 1);
+    static constexpr size_t OBJECTS_PER_CHUNK = (ChunkPages * PAGE_SIZE) / OBJECT_SIZE;
+
+    static_assert(OBJECTS_PER_CHUNK > 0, "object does not fit in a cache chunk");
+
+    void* allocate() {
+        if (!freeList && !grow()) return nullptr;
+
+        FreeObject* object = freeList;
+        freeList = object->next;
+
+        active++;
+        allocations++;
+        return object;
+    }
+
+    void free(void* ptr) {
+        if (!ptr) return;
+
+        FreeObject* object = static_cast<FreeObject*>(ptr);
+        object->next = freeList;
+        freeList = object;
+
+        active--;
+        frees++;
+    }
+
+    size_t getActive() const { return active; }
+    size_t getCapacity() const { return capacity; }
+    uint64_t getAllocations() const { return allocations; }
+    uint64_t getFrees() const { return frees; }
+
+private:
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    FreeObject* freeList;
+    size_t active;
+    size_t capacity;
+    uint64_t allocations;
+    uint64_t frees;
+
+    bool grow() {
+        void* phys = pmm.allocatePages(ChunkPages);
+        if (!phys) return false;
+
+        uint64_t base = reinterpret_cast<uint64_t>(phys) + hhdm_request.response->offset;
+        for (size_t i = OBJECTS_PER_CHUNK; i > 0; i--) {
+            FreeObject* object = reinterpret_cast<FreeObject*>(base + (i - 1) * OBJECT_SIZE);
+            object->next = freeList;
+            freeList = object;
+        }
+
+        capacity += OBJECTS_PER_CHUNK;
+        return true;
+    }
+};
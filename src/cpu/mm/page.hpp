@@ -1,6 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+
+constexpr size_t PAGE_SIZE = 4096;
+constexpr size_t PAGE_SIZE_2M = 0x200000;
+constexpr size_t PAGE_SIZE_1G = 0x40000000;
 
 struct PageTableEntry {
     uint64_t value;
@@ -1,4 +1,6 @@
 #include "pmm.hpp"
+#include <x86_64/requests.hpp>
+#include <string.h>
 PMM pmm;
 
 void PMM::init(uint8_t* bmpBuffer, uint64_t maxMemory) {
@@ -9,68 +11,308 @@ void PMM::init(uint8_t* bmpBuffer, uint64_t maxMemory) {
     freeMemory = 0;
     
     bitmap.init(bmpBuffer, pages);
+    cached.init(bmpBuffer + Bitmap::storageSize(pages), pages);
+    cached.clearRange(0, pages);
+
+    size_t zoneStart = 0;
+    for (size_t z = 0; z < ZONE_COUNT; z++) {
+        size_t zoneEnd = zoneLimit(z) < pages ? zoneLimit(z) : pages;
+        if (zoneEnd < zoneStart) zoneEnd = zoneStart;
+
+        zones[z].init(&bitmap, hhdm_request.response->offset, zoneStart, zoneEnd);
+        zoneStart = zoneEnd;
+    }
+
+    for (size_t i = 0; i < MAX_CPUS; i++) {
+        caches[i].count = 0;
+        caches[i].hits = 0;
+        caches[i].misses = 0;
+    }
+
+    zeroCount = 0;
+    zeroHits = 0;
+    zeroMisses = 0;
+
+    shareCounts = nullptr;
 
     intialized = true;
 }
 
-void* PMM::allocatePage() {
-    if (!intialized) return nullptr;
+size_t PMM::allocateIndex(uint32_t zoneMask, size_t count, size_t alignOrder) {
+    for (size_t z = ZONE_COUNT; z > 0; z--) {
+        if (!(zoneMask & (1u << (z - 1)))) continue;
 
-    size_t index = bitmap.findFirstFree();
-    if (index >= pages) {
-        return nullptr;
+        size_t index = zones[z - 1].allocateExact(count, alignOrder);
+        if (index != BuddyAllocator::INVALID_INDEX) return index;
     }
+    return BuddyAllocator::INVALID_INDEX;
+}
+
+void PMM::freeIndexRange(size_t index, size_t count) {
+    while (count) {
+        size_t zone = zoneFor(index);
+        size_t chunk = count;
+        if (chunk > zoneLimit(zone) - index) chunk = zoneLimit(zone) - index;
+
+        zones[zone].freeRange(index, chunk);
+        index += chunk;
+        count -= chunk;
+    }
+}
+
+void PMM::refillCache(PageCache& cache) {
+    size_t index = allocateIndex(PAGE_CACHE_ZONES, PAGE_CACHE_BATCH, 0);
+    if (index != BuddyAllocator::INVALID_INDEX) {
+        for (size_t i = PAGE_CACHE_BATCH; i > 0; i--) {
+            cache.frames[cache.count++] = index + i - 1;
+        }
+        cached.setRange(index, PAGE_CACHE_BATCH);
+        return;
+    }
+
+    while (cache.count < PAGE_CACHE_BATCH) {
+        index = allocateIndex(PAGE_CACHE_ZONES, 1, 0);
+        if (index == BuddyAllocator::INVALID_INDEX) break;
+        cache.frames[cache.count++] = index;
+        cached.set(index);
+    }
+}
+
+void PMM::drainCache(PageCache& cache, size_t count) {
+    if (count > cache.count) count = cache.count;
+
+    for (size_t i = 0; i < count; i++) {
+        cached.clear(cache.frames[i]);
+        zones[zoneFor(cache.frames[i])].free(cache.frames[i], 0);
+    }
+
+    for (size_t i = count; i < cache.count; i++) {
+        cache.frames[i - count] = cache.frames[i];
+    }
+    cache.count -= count;
+}
+
+void PMM::drainCaches() {
+    for (size_t i = 0; i < MAX_CPUS; i++) {
+        drainCache(caches[i], caches[i].count);
+    }
+
+    while (zeroCount) {
+        size_t index = zeroPool[--zeroCount];
+        cached.clear(index);
+        zones[zoneFor(index)].free(index, 0);
+    }
+}
+
+uint64_t PMM::getCacheHits() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < MAX_CPUS; i++) total += caches[i].hits;
+    return total;
+}
+
+uint64_t PMM::getCacheMisses() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < MAX_CPUS; i++) total += caches[i].misses;
+    return total;
+}
+
+size_t PMM::getFreeBlocks(size_t order) const {
+    size_t total = 0;
+    for (size_t z = 0; z < ZONE_COUNT; z++) total += zones[z].getFreeBlocks(order);
+    return total;
+}
+
+uint64_t PMM::getZoneFreeMemory(uint32_t zoneMask) const {
+    uint64_t total = 0;
+    for (size_t z = 0; z < ZONE_COUNT; z++) {
+        if (zoneMask & (1u << z)) total += zones[z].getFreePages() * PAGE_SIZE;
+    }
+    return total;
+}
+
+size_t PMM::getCachedPages() const {
+    size_t total = 0;
+    for (size_t i = 0; i < MAX_CPUS; i++) total += caches[i].count;
+    return total;
+}
+
+void* PMM::allocatePage(uint32_t zoneMask) {
+    if (!intialized || !(zoneMask & ZONE_ANY)) return nullptr;
+
+    if ((zoneMask & PAGE_CACHE_ZONES) != PAGE_CACHE_ZONES) {
+        return allocatePages(1, PAGE_SIZE, zoneMask);
+    }
+
+    PageCache& cache = caches[currentCPU()];
+    if (cache.count) {
+        cache.hits++;
+    } else {
+        cache.misses++;
+        refillCache(cache);
+        if (!cache.count) return allocatePages(1, PAGE_SIZE, zoneMask);
+    }
+
+    size_t index = cache.frames[--cache.count];
+    cached.clear(index);
 
-    bitmap.set(index);
     usedMemory += PAGE_SIZE;
     freeMemory -= PAGE_SIZE;
 
     return indexToAddress(index);
 }
 
-void* PMM::allocatePages(size_t count) {
-    if (!intialized || count == 0) return nullptr;
+void* PMM::allocatePages(size_t count, size_t alignment, uint32_t zoneMask) {
+    if (!intialized || count == 0 || !(zoneMask & ZONE_ANY)) return nullptr;
+    if (alignment & (alignment - 1)) return nullptr;
+
+    size_t alignOrder = 0;
+    if (alignment > PAGE_SIZE) {
+        alignOrder = BuddyAllocator::orderFor(alignment / PAGE_SIZE);
+    }
 
-    size_t index = bitmap.findFirstFreeRegion(count);
-    if (index >= pages) {
-        return nullptr;
+    size_t index = allocateIndex(zoneMask, count, alignOrder);
+    if (index == BuddyAllocator::INVALID_INDEX) {
+        drainCaches();
+        index = allocateIndex(zoneMask, count, alignOrder);
+        if (index == BuddyAllocator::INVALID_INDEX) return nullptr;
     }
 
-    bitmap.setRange(index, count);
     usedMemory += count * PAGE_SIZE;
     freeMemory -= count * PAGE_SIZE;
     
     return indexToAddress(index);
 }
 
+void* PMM::allocateZeroedPage(uint32_t zoneMask) {
+    if (!intialized) return nullptr;
+
+    if (zeroCount && (zoneMask & PAGE_CACHE_ZONES) == PAGE_CACHE_ZONES) {
+        zeroHits++;
+        usedMemory += PAGE_SIZE;
+        freeMemory -= PAGE_SIZE;
+
+        size_t index = zeroPool[--zeroCount];
+        cached.clear(index);
+        return indexToAddress(index);
+    }
+
+    zeroMisses++;
+    void* page = allocatePage(zoneMask);
+    if (!page) return nullptr;
+
+    memset(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(page) + hhdm_request.response->offset), 0, PAGE_SIZE);
+    return page;
+}
+
+bool PMM::zeroIdlePage() {
+    if (!intialized || zeroCount == ZERO_POOL_SIZE) return false;
+
+    void* page = allocatePage(PAGE_CACHE_ZONES);
+    if (!page) return false;
+
+    memset(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(page) + hhdm_request.response->offset), 0, PAGE_SIZE);
+    zeroPool[zeroCount++] = addressToIndex(page);
+    cached.set(addressToIndex(page));
+
+    usedMemory -= PAGE_SIZE;
+    freeMemory += PAGE_SIZE;
+    return true;
+}
+
+size_t PMM::releaseRange(size_t index, size_t count) {
+    size_t end = index + count;
+    size_t released = 0;
+
+    while (index < end) {
+        size_t runStart = bitmap.findNextSet(index, end);
+        if (runStart >= end) break;
+
+        size_t runEnd = bitmap.findNextClear(runStart, end);
+
+        while (runStart < runEnd) {
+            size_t cachedStart = cached.findNextSet(runStart, runEnd);
+            if (cachedStart > runEnd) cachedStart = runEnd;
+
+            freeIndexRange(runStart, cachedStart - runStart);
+            released += cachedStart - runStart;
+
+            if (cachedStart >= runEnd) break;
+            runStart = cached.findNextClear(cachedStart, runEnd);
+        }
+
+        index = runEnd;
+    }
+
+    return released;
+}
+
 void PMM::freePage(void* page) {
     if (!intialized || !page) return;
     
     size_t index = addressToIndex(page);
     if (index >= pages) return;
 
-    if (bitmap.get(index)) {
-        bitmap.clear(index);
-        if(usedMemory -PAGE_SIZE > 0)
-            usedMemory -= PAGE_SIZE;
+    if (!bitmap.get(index) || cached.get(index)) return;
+
+    if (shareCounts && shareCounts[index]) {
+        shareCounts[index]--;
+        return;
+    }
+
+    if (zoneFor(index) == 0) {
+        zones[0].free(index, 0);
+        usedMemory -= PAGE_SIZE;
         freeMemory += PAGE_SIZE;
+        return;
+    }
+
+    PageCache& cache = caches[currentCPU()];
+    if (cache.count == PAGE_CACHE_SIZE) {
+        drainCache(cache, PAGE_CACHE_BATCH);
     }
+    cache.frames[cache.count++] = index;
+    cached.set(index);
+
+    usedMemory -= PAGE_SIZE;
+    freeMemory += PAGE_SIZE;
 }
 
 void PMM::freePages(void* page, size_t count) {
     if (!intialized || !page || count == 0) return;
 
+    if (count == 1) {
+        freePage(page);
+        return;
+    }
+
     size_t index = addressToIndex(page);
     if (index >= pages) return;
+    if (count > pages - index) count = pages - index;
 
-    for (size_t i = 0; i < count; i++) {
-        if (index + i < pages && bitmap.get(index + i)) {
-            bitmap.clear(index + i);
-            if(usedMemory -PAGE_SIZE > 0)
-                usedMemory -= PAGE_SIZE;
-            freeMemory += PAGE_SIZE;
-        }
-    }
+    size_t released = releaseRange(index, count);
+
+    usedMemory -= released * PAGE_SIZE;
+    freeMemory += released * PAGE_SIZE;
+}
+
+void PMM::freeRegion(uint64_t base, uint64_t length) {
+    if (!intialized || length == 0) return;
+
+    uint64_t start = (base + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint64_t end = (base + length) & ~(PAGE_SIZE - 1);
+    if (start == 0) start = PAGE_SIZE;
+    if (end <= start) return;
+
+    size_t index = addressToIndex(reinterpret_cast<void*>(start));
+    if (index >= pages) return;
+
+    size_t count = (end - start) / PAGE_SIZE;
+    if (count > pages - index) count = pages - index;
+
+    size_t released = releaseRange(index, count);
+
+    usedMemory -= released * PAGE_SIZE;
+    freeMemory += released * PAGE_SIZE;
 }
 
 void PMM::reservePage(void* page) {
@@ -79,9 +321,10 @@ void PMM::reservePage(void* page) {
     size_t index = addressToIndex(page);
     if (index >= pages) return;
 
-    if (!bitmap.get(index)) {
-        bitmap.set(index);
+    drainCaches();
+    if (!bitmap.get(index) && zones[zoneFor(index)].claim(index)) {
         reservedMemory += PAGE_SIZE;
+        freeMemory -= PAGE_SIZE;
     }
 }
 
@@ -90,15 +333,21 @@ void PMM::reservePages(void* page, size_t count) {
 
     size_t index = addressToIndex(page);
     if (index >= pages) return;
+    if (count > pages - index) count = pages - index;
 
-    for (size_t i = 0; i < count; i++) {
-        if (index + i < pages) {
-            if (!bitmap.get(index + i)) {
-                bitmap.set(index + i);
-                reservedMemory += PAGE_SIZE;
-            }
+    size_t end = index + count;
+    size_t reserved = 0;
+
+    drainCaches();
+
+    for (size_t i = bitmap.findNextClear(index, end); i < end; i = bitmap.findNextClear(i + 1, end)) {
+        if (zones[zoneFor(i)].claim(i)) {
+            reserved++;
         }
     }
+
+    reservedMemory += reserved * PAGE_SIZE;
+    freeMemory -= reserved * PAGE_SIZE;
 }
 
 void PMM::reserveRegion(uint64_t base, uint64_t length) {
@@ -107,4 +356,34 @@ void PMM::reserveRegion(uint64_t base, uint64_t length) {
     uint64_t aligned_base = base & ~(PAGE_SIZE - 1);
     size_t page_count = (length + (base - aligned_base) + PAGE_SIZE - 1) / PAGE_SIZE;
     reservePages(reinterpret_cast<void*>(aligned_base), page_count);
-}
\ No newline at end of file
+}
+
+bool PMM::sharePage(void* page) {
+    if (!intialized || !page) return false;
+
+    size_t index = addressToIndex(page);
+    if (index >= pages || !bitmap.get(index) || cached.get(index)) return false;
+
+    if (!shareCounts) {
+        size_t countPages = (pages * sizeof(uint16_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+        void* phys = allocatePages(countPages);
+        if (!phys) return false;
+
+        shareCounts = reinterpret_cast<uint16_t*>(reinterpret_cast<uint64_t>(phys) + hhdm_request.response->offset);
+        memset(shareCounts, 0, countPages * PAGE_SIZE);
+    }
+
+    if (shareCounts[index] == UINT16_MAX) return false;
+
+    shareCounts[index]++;
+    return true;
+}
+
+size_t PMM::getShareCount(void* page) const {
+    if (!shareCounts) return 0;
+
+    size_t index = addressToIndex(page);
+    if (index >= pages) return 0;
+
+    return shareCounts[index];
+}
@@ -1,36 +1,87 @@
 #pragma once
 
 #include "bitmap.hpp"
+#include "buddy.hpp"
+#include "page.hpp"
 #include <cstdint>
 #include <cstddef>
 
-constexpr size_t PAGE_SIZE = 4096;
+constexpr size_t MAX_CPUS = 16;
+constexpr size_t PAGE_CACHE_SIZE = 64;
+constexpr size_t PAGE_CACHE_BATCH_ORDER = 4;
+constexpr size_t PAGE_CACHE_BATCH = 1 << PAGE_CACHE_BATCH_ORDER;
+constexpr size_t ZERO_POOL_SIZE = 256;
+
+constexpr uint32_t ZONE_DMA = 1 << 0;
+constexpr uint32_t ZONE_DMA32 = 1 << 1;
+constexpr uint32_t ZONE_NORMAL = 1 << 2;
+constexpr uint32_t ZONE_ANY = ZONE_DMA | ZONE_DMA32 | ZONE_NORMAL;
+constexpr size_t ZONE_COUNT = 3;
+
+constexpr uint64_t ZONE_DMA_LIMIT = 0x1000000;
+constexpr uint64_t ZONE_DMA32_LIMIT = 0x100000000;
+
+// The per-CPU caches only hold frames above 16 MiB
+constexpr uint32_t PAGE_CACHE_ZONES = ZONE_DMA32 | ZONE_NORMAL;
+
+struct PageCache {
+    size_t frames[PAGE_CACHE_SIZE];
+    size_t count;
+    uint64_t hits;
+    uint64_t misses;
+};
 
 class PMM {
 public:
     PMM() : intialized(false), availableMemory(0), usedMemory(0), 
-            freeMemory(0), pages(0) {}
+            freeMemory(0), pages(0), shareCounts(nullptr) {}
 
     void init(uint8_t* bmpBuffer, uint64_t maxMemory);
 
-    void* allocatePage();
-    void* allocatePages(size_t count);
+    static size_t storageSize(uint64_t maxMemory) {
+        return 2 * Bitmap::storageSize(maxMemory / PAGE_SIZE);
+    }
+
+    void* allocatePage(uint32_t zoneMask = ZONE_ANY);
+    void* allocatePages(size_t count, size_t alignment = PAGE_SIZE, uint32_t zoneMask = ZONE_ANY);
+    void* allocateZeroedPage(uint32_t zoneMask = ZONE_ANY);
+    bool zeroIdlePage();
     void freePage(void* page);
     void freePages(void* page, size_t count);
+    void freeRegion(uint64_t base, uint64_t length);
     void reservePage(void* page);
     void reservePages(void* page, size_t count);
     void reserveRegion(uint64_t base, uint64_t length);
+
+    bool sharePage(void* page);
+    size_t getShareCount(void* page) const;
     
     uint64_t getTotalMemory() const { return availableMemory; }
     uint64_t getUsedMemory() const { return usedMemory; }
     uint64_t getFreeMemory() const { return freeMemory; }
     uint64_t getReservedMemory() const { return reservedMemory; }
     size_t getPageCount() const { return pages; }
+    size_t getFreeBlocks(size_t order) const;
+    uint64_t getZoneFreeMemory(uint32_t zoneMask) const;
+
+    uint64_t getCacheHits() const;
+    uint64_t getCacheMisses() const;
+    size_t getCachedPages() const;
+    void drainCaches();
+
+    size_t getZeroedPages() const { return zeroCount; }
+    uint64_t getZeroHits() const { return zeroHits; }
+    uint64_t getZeroMisses() const { return zeroMisses; }
     
     bool isInitialized() const { return intialized; }
     
 private:
     Bitmap bitmap;
+    // Frames parked in a page cache or the zero pool stay set in bitmap so the
+    // buddy allocator never merges them; this tracks them so they cannot be
+    // freed a second time.
+    Bitmap cached;
+    BuddyAllocator zones[ZONE_COUNT];
     bool intialized;
 
     uint64_t availableMemory;
@@ -39,6 +90,19 @@ private:
     uint64_t freeMemory;
     size_t pages;
 
+    PageCache caches[MAX_CPUS];
+
+    size_t zeroPool[ZERO_POOL_SIZE];
+    size_t zeroCount;
+    uint64_t zeroHits;
+    uint64_t zeroMisses;
+
+    uint16_t* shareCounts;
+
+    static size_t currentCPU() { return 0; }
+    void refillCache(PageCache& cache);
+    void drainCache(PageCache& cache, size_t count);
+
     size_t addressToIndex(void* addr) const {
         return reinterpret_cast<uint64_t>(addr) / PAGE_SIZE;
     }
@@ -46,6 +110,22 @@ private:
     void* indexToAddress(size_t index) const {
         return reinterpret_cast<void*>(index * PAGE_SIZE);
     }
+
+    static size_t zoneLimit(size_t zone) {
+        if (zone == 0) return ZONE_DMA_LIMIT / PAGE_SIZE;
+        if (zone == 1) return ZONE_DMA32_LIMIT / PAGE_SIZE;
+        return ~static_cast<size_t>(0);
+    }
+
+    static size_t zoneFor(size_t index) {
+        size_t zone = 0;
+        while (index >= zoneLimit(zone)) zone++;
+        return zone;
+    }
+
+    size_t allocateIndex(uint32_t zoneMask, size_t count, size_t alignOrder);
+    void freeIndexRange(size_t index, size_t count);
+    size_t releaseRange(size_t index, size_t count);
 };
 
 extern PMM pmm;
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "shm.hpp"
+#include "pmm.hpp"
+#include <string.h>
+
+SharedMemory sharedMemoryInstance;
+
+SharedMemory& SharedMemory::get() {
+    return sharedMemoryInstance;
+}
+
+int64_t SharedMemory::makeID(size_t index) const {
+    return (static_cast<int64_t>(segments[index].generation) << 8) | index;
+}
+
+SharedSegment* SharedMemory::find(const char* name) {
+    for (size_t i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (segments[i].used && strcmp(segments[i].name, name) == 0) {
+            return &segments[i];
+        }
+    }
+    return nullptr;
+}
+
+int64_t SharedMemory::create(const char* name, uint64_t size) {
+    size_t length = strlen(name);
+    if (length == 0 || length >= SHM_NAME_LENGTH) return -1;
+    if (size == 0 || size > SHM_MAX_PAGES * PAGE_SIZE) return -1;
+    if (find(name)) return -1;
+
+    size_t index = SHM_MAX_SEGMENTS;
+    for (size_t i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (!segments[i].used) {
+            index = i;
+            break;
+        }
+    }
+    if (index == SHM_MAX_SEGMENTS) return -1;
+
+    size_t pageCount = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    void** frames = new void*[pageCount];
+    if (!frames) return -1;
+
+    for (size_t i = 0; i < pageCount; i++) {
+        frames[i] = pmm.allocateZeroedPage();
+        if (!frames[i]) {
+            while (i > 0) {
+                pmm.freePage(frames[--i]);
+            }
+            delete[] frames;
+            return -1;
+        }
+    }
+
+    SharedSegment& segment = segments[index];
+    memcpy(segment.name, name, length + 1);
+    segment.frames = frames;
+    segment.pageCount = pageCount;
+    segment.used = true;
+
+    return makeID(index);
+}
+
+int64_t SharedMemory::open(const char* name) {
+    SharedSegment* segment = find(name);
+    if (!segment) return -1;
+
+    return makeID(segment - segments);
+}
+
+bool SharedMemory::unlink(const char* name) {
+    SharedSegment* segment = find(name);
+    if (!segment) return false;
+
+    for (size_t i = 0; i < segment->pageCount; i++) {
+        pmm.freePage(segment->frames[i]);
+    }
+    delete[] segment->frames;
+
+    segment->frames = nullptr;
+    segment->pageCount = 0;
+    segment->generation++;
+    segment->used = false;
+
+    return true;
+}
+
+SharedSegment* SharedMemory::getSegment(int64_t id) {
+    if (id < 0) return nullptr;
+
+    size_t index = id & 0xFF;
+    if (index >= SHM_MAX_SEGMENTS) return nullptr;
+
+    SharedSegment& segment = segments[index];
+    if (!segment.used || makeID(index) != id) return nullptr;
+
+    return &segment;
+}
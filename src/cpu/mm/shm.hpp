@@ -0,0 +1,37 @@
+#pragma once
+
+#include "page.hpp"
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t SHM_MAX_SEGMENTS = 32;
+constexpr size_t SHM_NAME_LENGTH = 32;
+constexpr size_t SHM_MAX_PAGES = 16384;
+
+// The segment holds one reference on each frame; every mapping takes another
+// through the PMM share count, so unlinking a segment only drops the name and
+// the frames live on until the last mapping goes away.
+struct SharedSegment {
+    char name[SHM_NAME_LENGTH];
+    void** frames;
+    size_t pageCount;
+    uint32_t generation;
+    bool used;
+};
+
+class SharedMemory {
+public:
+    static SharedMemory& get();
+
+    int64_t create(const char* name, uint64_t size);
+    int64_t open(const char* name);
+    bool unlink(const char* name);
+
+    SharedSegment* getSegment(int64_t id);
+
+private:
+    SharedSegment segments[SHM_MAX_SEGMENTS];
+
+    SharedSegment* find(const char* name);
+    int64_t makeID(size_t index) const;
+};
@@ -0,0 +1,191 @@
+#include "slab.hpp"
+#include <x86_64/requests.hpp>
+#include <string.h>
+
+constexpr size_t SLAB_KEEP_EMPTY = 1;
+
+void SlabAllocator::init() {
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++) {
+        SlabCache& cache = caches[i];
+        cache.objectSize = static_cast<size_t>(1) << (i + SLAB_MIN_SHIFT);
+        cache.partial = nullptr;
+        cache.full = nullptr;
+        cache.emptySlabs = 0;
+        cache.slabCount = 0;
+        cache.activeObjects = 0;
+        cache.totalObjects = 0;
+        cache.allocations = 0;
+        cache.frees = 0;
+    }
+
+    size_t blocks = pmm.getPageCount() / SLAB_PAGES;
+    size_t storagePages = (Bitmap::storageSize(blocks) + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    void* phys = pmm.allocatePages(storagePages);
+    if (!phys) return;
+
+    owned.init(reinterpret_cast<uint8_t*>(reinterpret_cast<uint64_t>(phys) + hhdm_request.response->offset), blocks);
+    owned.clearRange(0, blocks);
+}
+
+bool SlabAllocator::owns(void* ptr) const {
+    uint64_t hhdm = hhdm_request.response->offset;
+    uint64_t addr = reinterpret_cast<uint64_t>(ptr);
+    if (addr < hhdm) return false;
+
+    size_t index = (addr - hhdm) / SLAB_SIZE;
+    return index < owned.size() && owned.get(index);
+}
+
+void SlabAllocator::push(Slab*& list, Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = list;
+    if (list) {
+        list->prev = slab;
+    }
+    list = slab;
+}
+
+void SlabAllocator::unlink(Slab*& list, Slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list = slab->next;
+    }
+
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+Slab* SlabAllocator::createSlab(SlabCache& cache) {
+    void* phys = pmm.allocatePages(SLAB_PAGES, SLAB_SIZE);
+    if (!phys) return nullptr;
+
+    size_t block = reinterpret_cast<uint64_t>(phys) / SLAB_SIZE;
+    if (!owned.set(block)) {
+        pmm.freePages(phys, SLAB_PAGES);
+        return nullptr;
+    }
+
+    Slab* slab = reinterpret_cast<Slab*>(reinterpret_cast<uint64_t>(phys) + hhdm_request.response->offset);
+    slab->cache = &cache;
+    slab->inUse = 0;
+    slab->magic = Slab::defaultMagic;
+    memset(slab->allocated, 0, sizeof(slab->allocated));
+
+    size_t first = (sizeof(Slab) + cache.objectSize - 1) & ~(cache.objectSize - 1);
+    slab->capacity = (SLAB_SIZE - first) / cache.objectSize;
+
+    uint64_t base = reinterpret_cast<uint64_t>(slab) + first;
+    slab->freeList = nullptr;
+    for (size_t i = slab->capacity; i > 0; i--) {
+        SlabObject* object = reinterpret_cast<SlabObject*>(base + (i - 1) * cache.objectSize);
+        object->next = slab->freeList;
+        slab->freeList = object;
+    }
+
+    push(cache.partial, slab);
+    cache.emptySlabs++;
+    cache.slabCount++;
+    cache.totalObjects += slab->capacity;
+
+    return slab;
+}
+
+void SlabAllocator::destroySlab(SlabCache& cache, Slab* slab) {
+    unlink(cache.partial, slab);
+    cache.emptySlabs--;
+    cache.slabCount--;
+    cache.totalObjects -= slab->capacity;
+
+    slab->magic = 0;
+
+    uint64_t phys = reinterpret_cast<uint64_t>(slab) - hhdm_request.response->offset;
+    owned.clear(phys / SLAB_SIZE);
+    pmm.freePages(reinterpret_cast<void*>(phys), SLAB_PAGES);
+}
+
+void* SlabAllocator::allocate(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE) return nullptr;
+
+    SlabCache& cache = caches[classFor(size)];
+
+    Slab* slab = cache.partial;
+    if (!slab) {
+        slab = createSlab(cache);
+        if (!slab) return nullptr;
+    }
+
+    if (slab->inUse == 0) {
+        cache.emptySlabs--;
+    }
+
+    SlabObject* object = slab->freeList;
+    slab->freeList = object->next;
+    slab->inUse++;
+    slab->setAllocated((reinterpret_cast<uint64_t>(object) - reinterpret_cast<uint64_t>(slab)) / cache.objectSize, true);
+
+    if (slab->inUse == slab->capacity) {
+        unlink(cache.partial, slab);
+        push(cache.full, slab);
+    }
+
+    cache.activeObjects++;
+    cache.allocations++;
+
+    return object;
+}
+
+void SlabAllocator::free(void* ptr) {
+    if (!ptr || !owns(ptr)) return;
+
+    Slab* slab = slabOf(ptr);
+    if (!slab->isValid() || slab->inUse == 0) return;
+
+    SlabCache& cache = *slab->cache;
+
+    uint64_t offset = reinterpret_cast<uint64_t>(ptr) - reinterpret_cast<uint64_t>(slab);
+    if (offset < sizeof(Slab) || (offset & (cache.objectSize - 1))) return;
+
+    size_t index = offset / cache.objectSize;
+    if (!slab->isAllocated(index)) return;
+    slab->setAllocated(index, false);
+
+    if (slab->inUse == slab->capacity) {
+        unlink(cache.full, slab);
+        push(cache.partial, slab);
+    }
+
+    SlabObject* object = reinterpret_cast<SlabObject*>(ptr);
+    object->next = slab->freeList;
+    slab->freeList = object;
+    slab->inUse--;
+
+    cache.activeObjects--;
+    cache.frees++;
+
+    if (slab->inUse == 0) {
+        cache.emptySlabs++;
+        if (cache.emptySlabs > SLAB_KEEP_EMPTY) {
+            destroySlab(cache, slab);
+        }
+    }
+}
+
+size_t SlabAllocator::objectSize(void* ptr) const {
+    if (!owns(ptr)) return 0;
+
+    Slab* slab = slabOf(ptr);
+    if (!slab->isValid()) return 0;
+
+    return slab->cache->objectSize;
+}
+
+size_t SlabAllocator::getSlabPages() const {
+    size_t total = 0;
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++) {
+        total += caches[i].slabCount * SLAB_PAGES;
+    }
+    return total;
+}
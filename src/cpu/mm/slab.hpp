@@ -0,0 +1,95 @@
+#pragma once
+
+#include "pmm.hpp"
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t SLAB_MIN_SHIFT = 4;
+constexpr size_t SLAB_MAX_SHIFT = 11;
+constexpr size_t SLAB_CLASS_COUNT = SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1;
+constexpr size_t SLAB_MAX_SIZE = static_cast<size_t>(1) << SLAB_MAX_SHIFT;
+constexpr size_t SLAB_PAGES = 4;
+constexpr size_t SLAB_SIZE = SLAB_PAGES * PAGE_SIZE;
+constexpr size_t SLAB_MAX_OBJECTS = SLAB_SIZE >> SLAB_MIN_SHIFT;
+
+struct SlabCache;
+
+struct SlabObject {
+    SlabObject* next;
+};
+
+struct Slab {
+    Slab* next;
+    Slab* prev;
+    SlabCache* cache;
+    SlabObject* freeList;
+    uint32_t inUse;
+    uint32_t capacity;
+    uint32_t magic;
+    uint64_t allocated[SLAB_MAX_OBJECTS / 64];
+
+    static constexpr uint32_t defaultMagic = 0x51ab0b1e;
+
+    bool isValid() const {
+        return magic == defaultMagic;
+    }
+
+    bool isAllocated(size_t index) const {
+        return allocated[index / 64] & (1ULL << (index % 64));
+    }
+
+    void setAllocated(size_t index, bool value) {
+        if (value) {
+            allocated[index / 64] |= 1ULL << (index % 64);
+        } else {
+            allocated[index / 64] &= ~(1ULL << (index % 64));
+        }
+    }
+};
+
+struct SlabCache {
+    size_t objectSize;
+    Slab* partial;
+    Slab* full;
+    size_t emptySlabs;
+
+    size_t slabCount;
+    size_t activeObjects;
+    size_t totalObjects;
+    uint64_t allocations;
+    uint64_t frees;
+};
+
+class SlabAllocator {
+public:
+    void init();
+
+    void* allocate(size_t size);
+    void free(void* ptr);
+    size_t objectSize(void* ptr) const;
+    bool owns(void* ptr) const;
+
+    const SlabCache& getCache(size_t index) const { return caches[index]; }
+    size_t getSlabPages() const;
+
+    static size_t classFor(size_t size) {
+        size_t shift = SLAB_MIN_SHIFT;
+        while ((static_cast<size_t>(1) << shift) < size) shift++;
+        return shift - SLAB_MIN_SHIFT;
+    }
+
+private:
+    SlabCache caches[SLAB_CLASS_COUNT];
+    // One bit per SLAB_SIZE block of physical memory currently used as a slab.
+    Bitmap owned;
+
+    Slab* createSlab(SlabCache& cache);
+    void destroySlab(SlabCache& cache, Slab* slab);
+
+    static Slab* slabOf(void* ptr) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uint64_t>(ptr) & ~(SLAB_SIZE - 1));
+    }
+
+    static void push(Slab*& list, Slab* slab);
+    static void unlink(Slab*& list, Slab* slab);
+};
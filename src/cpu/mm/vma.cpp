@@ -0,0 +1,157 @@
+#include "vma.hpp"
+#include "heap.hpp"
+#include <string.h>
+
+void VMAList::destroy() {
+    if (areas) {
+        kheap.free(areas);
+    }
+
+    areas = nullptr;
+    count = 0;
+    capacity = 0;
+    residentPages = 0;
+}
+
+bool VMAList::reserve(size_t needed) {
+    if (needed <= capacity) return true;
+
+    size_t newCapacity = capacity ? capacity * 2 : VMA_INITIAL_CAPACITY;
+    while (newCapacity < needed) newCapacity *= 2;
+
+    VMA* grown = static_cast<VMA*>(kheap.reallocate(areas, newCapacity * sizeof(VMA)));
+    if (!grown) return false;
+
+    areas = grown;
+    capacity = newCapacity;
+    return true;
+}
+
+size_t VMAList::lowerBound(uint64_t addr) const {
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (areas[mid].end <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+VMA* VMAList::find(uint64_t addr) {
+    size_t index = lowerBound(addr);
+    if (index < count && areas[index].contains(addr)) {
+        return &areas[index];
+    }
+    return nullptr;
+}
+
+bool VMAList::isFree(uint64_t start, uint64_t end) const {
+    size_t index = lowerBound(start);
+    return index == count || areas[index].start >= end;
+}
+
+uint64_t VMAList::findFree(size_t size, uint64_t base, uint64_t limit) const {
+    if (size == 0 || limit < base || limit - base < size) return 0;
+
+    uint64_t candidate = base;
+    for (size_t i = lowerBound(base); i < count; i++) {
+        if (areas[i].start >= limit) break;
+        if (areas[i].start >= candidate && areas[i].start - candidate >= size) {
+            return candidate;
+        }
+        if (areas[i].end > candidate) {
+            candidate = areas[i].end;
+        }
+    }
+
+    if (candidate > limit || limit - candidate < size) return 0;
+    return candidate;
+}
+
+VMA* VMAList::insert(uint64_t start, uint64_t end, uint32_t prot, VMAType type, uint32_t flags) {
+    if (start >= end || !isFree(start, end)) return nullptr;
+    if (!reserve(count + 1)) return nullptr;
+
+    size_t index = lowerBound(start);
+    memmove(&areas[index + 1], &areas[index], (count - index) * sizeof(VMA));
+    count++;
+
+    VMA& area = areas[index];
+    area.start = start;
+    area.end = end;
+    area.prot = prot;
+    area.flags = flags;
+    area.type = type;
+    area.source = nullptr;
+    area.sourceSize = 0;
+
+    return &area;
+}
+
+bool VMAList::remove(uint64_t start, uint64_t end) {
+    size_t index = lowerBound(start);
+
+    if (index < count && areas[index].start < start && areas[index].end > end) {
+        if (!reserve(count + 1)) return false;
+
+        memmove(&areas[index + 1], &areas[index], (count - index) * sizeof(VMA));
+        count++;
+
+        areas[index].end = start;
+        areas[index + 1].trimFront(end);
+        return true;
+    }
+
+    size_t first = index;
+    size_t removed = 0;
+
+    for (size_t i = index; i < count && areas[i].start < end; i++) {
+        VMA& area = areas[i];
+
+        if (area.start >= start && area.end <= end) {
+            removed++;
+            continue;
+        }
+
+        if (area.start < start) {
+            area.end = start;
+            first = i + 1;
+        } else {
+            area.trimFront(end);
+        }
+    }
+
+    memmove(&areas[first], &areas[first + removed], (count - first - removed) * sizeof(VMA));
+    count -= removed;
+
+    return true;
+}
+
+bool VMAList::split(uint64_t addr) {
+    size_t index = lowerBound(addr);
+    if (index == count || areas[index].start >= addr) return true;
+    if (!reserve(count + 1)) return false;
+
+    memmove(&areas[index + 1], &areas[index], (count - index) * sizeof(VMA));
+    count++;
+
+    areas[index].end = addr;
+    areas[index + 1].trimFront(addr);
+    return true;
+}
+
+bool VMAList::copyFrom(const VMAList& other) {
+    count = 0;
+    if (!reserve(other.count)) return false;
+
+    memcpy(areas, other.areas, other.count * sizeof(VMA));
+    count = other.count;
+    residentPages = other.residentPages;
+    return true;
+}
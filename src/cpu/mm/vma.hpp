@@ -0,0 +1,87 @@
+#pragma once
+
+#include "page.hpp"
+#include <cstdint>
+#include <cstddef>
+
+constexpr uint32_t PROT_READ = 1;
+constexpr uint32_t PROT_WRITE = 2;
+constexpr uint32_t PROT_EXEC = 4;
+
+constexpr uint32_t MAP_SHARED = 0x01;
+constexpr uint32_t MAP_PRIVATE = 0x02;
+constexpr uint32_t MAP_ANONYMOUS = 0x20;
+
+constexpr uint32_t VMA_DEMAND = 1 << 0;
+
+constexpr size_t VMA_INITIAL_CAPACITY = 8;
+
+enum class VMAType : uint8_t {
+    Anonymous,
+    Stack,
+    Image,
+    Framebuffer,
+    Shared
+};
+
+struct VMA {
+    uint64_t start;
+    uint64_t end;
+    uint32_t prot;
+    uint32_t flags;
+    VMAType type;
+
+    // Image areas populated from memory that outlives the process (the initrd).
+    // source is the byte backing start; pages past sourceSize are zero filled.
+    const uint8_t* source;
+    uint64_t sourceSize;
+
+    bool contains(uint64_t addr) const {
+        return addr >= start && addr < end;
+    }
+
+    size_t pageCount() const {
+        return (end - start) / PAGE_SIZE;
+    }
+
+    void trimFront(uint64_t newStart) {
+        uint64_t delta = newStart - start;
+        if (source) {
+            source += delta;
+            sourceSize = sourceSize > delta ? sourceSize - delta : 0;
+        }
+        start = newStart;
+    }
+};
+
+class VMAList {
+public:
+    VMAList() : areas(nullptr), count(0), capacity(0), residentPages(0) {}
+
+    void destroy();
+
+    VMA* find(uint64_t addr);
+    VMA* insert(uint64_t start, uint64_t end, uint32_t prot, VMAType type, uint32_t flags = 0);
+    bool remove(uint64_t start, uint64_t end);
+    bool split(uint64_t addr);
+    bool copyFrom(const VMAList& other);
+
+    uint64_t findFree(size_t size, uint64_t base, uint64_t limit) const;
+    bool isFree(uint64_t start, uint64_t end) const;
+
+    size_t lowerBound(uint64_t addr) const;
+    VMA& at(size_t index) { return areas[index]; }
+    size_t getCount() const { return count; }
+
+    void addResident(size_t pages) { residentPages += pages; }
+    void removeResident(size_t pages) { residentPages -= pages < residentPages ? pages : residentPages; }
+    size_t getResidentPages() const { return residentPages; }
+
+private:
+    VMA* areas;
+    size_t count;
+    size_t capacity;
+    size_t residentPages;
+
+    bool reserve(size_t needed);
+};
@@ -1,26 +1,141 @@
 
 #include "vmm.hpp"
 #include <x86_64/requests.hpp>
+#include <x86_64/ports.hpp>
+#include <string.h>
 
 VMM vmm;
 
-VMM::VMM() : _pml4(nullptr), initialized(false) {}
+static bool pcidEnabled;
+static bool patEnabled;
+static uint64_t pcidBitmap[PCID_COUNT / 64];
+
+VMM::VMM() : _pml4(nullptr), initialized(false), ownsRoot(false), pcid(0), stale(false) {}
 
 void VMM::init(PageTable* pml4) {
     if (pml4) {
         _pml4 = (PageTable*)((uint64_t)pml4 + hhdm_request.response->offset);
     } else {
-        _pml4 = (PageTable*)((uint64_t)pmm.allocatePage() + hhdm_request.response->offset);
-        if (!_pml4) return;
+        void* page = pmm.allocateZeroedPage();
+        if (!page) return;
 
-        for (int i = 0; i < 512; i++) {
-            _pml4->entries[i].clear();
-        }
+        _pml4 = (PageTable*)((uint64_t)page + hhdm_request.response->offset);
     }
 
+    ownsRoot = pml4 == nullptr;
+    pcid = 0;
+    stale = true;
     initialized = true;
 }
 
+void VMM::release() {
+    if (!initialized || !ownsRoot) return;
+
+    if (isActive()) {
+        vmm.load();
+    }
+
+    for (size_t i = 0; i < 256; i++) {
+        PageTableEntry& entry = _pml4->entries[i];
+        if (entry.hasFlag(PTE_PRESENT)) {
+            freeTable(entry, 0);
+        }
+        entry.clear();
+    }
+
+    pmm.freePage(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(_pml4) - hhdm_request.response->offset));
+    _pml4 = nullptr;
+    initialized = false;
+
+    if (pcid) {
+        pcidBitmap[pcid / 64] &= ~(1ULL << (pcid % 64));
+        pcid = 0;
+    }
+}
+
+// Address spaces only take a PCID once they are about to be loaded, so
+// templates that never reach CR3 do not use up the tag space.
+void VMM::assignPCID() {
+    if (pcid || !pcidEnabled || !ownsRoot) return;
+
+    pcid = allocatePCID();
+    stale = true;
+}
+
+uint16_t VMM::allocatePCID() {
+    for (size_t i = 0; i < PCID_COUNT / 64; i++) {
+        uint64_t free = ~pcidBitmap[i];
+        if (i == 0) free &= ~1ULL;
+        if (!free) continue;
+
+        size_t bit = __builtin_ctzll(free);
+        pcidBitmap[i] |= 1ULL << bit;
+        return static_cast<uint16_t>(i * 64 + bit);
+    }
+
+    return 0;
+}
+
+void VMM::setupTLB() {
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    vmm.markGlobal(vmm._pml4, 0);
+    cr4 |= CR4_PGE;
+
+    uint32_t eax = 1, ebx = 0, ecx = 0, edx = 0;
+    cpuid(&eax, &ebx, &ecx, &edx);
+    if ((ecx >> 17) & 1) {
+        cr4 |= CR4_PCIDE;
+        pcidEnabled = true;
+    }
+
+    asm volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+    flushAll(true);
+}
+
+void VMM::setupPAT() {
+    uint32_t eax = 1, ebx = 0, ecx = 0, edx = 0;
+    cpuid(&eax, &ebx, &ecx, &edx);
+    if (!((edx >> 16) & 1)) return;
+
+    asm volatile("wbinvd" ::: "memory");
+    asm volatile("wrmsr" :: "a"(static_cast<uint32_t>(PAT_VALUE)),
+                 "d"(static_cast<uint32_t>(PAT_VALUE >> 32)), "c"(MSR_PAT) : "memory");
+    asm volatile("wbinvd" ::: "memory");
+    flushAll(true);
+
+    patEnabled = true;
+}
+
+uint64_t VMM::typeFlags(MemoryType type) {
+    switch (type) {
+        case MemoryType::WriteCombining:
+            if (patEnabled) return PTE_WRITE_THROUGH;
+            return PTE_CACHE_DISABLE | PTE_WRITE_THROUGH;
+        case MemoryType::WriteThrough:
+            if (patEnabled) return PTE_HUGE_PAT | PTE_WRITE_THROUGH;
+            return PTE_WRITE_THROUGH;
+        case MemoryType::Uncached:
+            return PTE_CACHE_DISABLE | PTE_WRITE_THROUGH;
+        default:
+            return 0;
+    }
+}
+
+void VMM::markGlobal(PageTable* table, size_t level) {
+    for (size_t i = level == 0 ? 256 : 0; i < 512; i++) {
+        PageTableEntry& entry = table->entries[i];
+        if (!entry.hasFlag(PTE_PRESENT)) continue;
+
+        if (level == 3 || (level > 0 && entry.hasFlag(PTE_HUGE))) {
+            entry.addFlags(PTE_GLOBAL);
+        } else {
+            markGlobal(getTable(entry), level + 1);
+        }
+    }
+}
+
 PageTable* VMM::getOrCreateTable(PageTableEntry& entry) {
     if (entry.hasFlag(PTE_PRESENT)) {
         uint64_t phys = entry.getAddress();
@@ -29,16 +144,12 @@ PageTable* VMM::getOrCreateTable(PageTableEntry& entry) {
 
     }
     
-    void* page = pmm.allocatePage();
+    void* page = pmm.allocateZeroedPage();
     if (!page) return nullptr;
     
     uint64_t phys = (uint64_t)page;
     PageTable* table = (PageTable*)(phys + hhdm_request.response->offset);
     
-    for (int i = 0; i < 512; i++) {
-        table->entries[i].clear();
-    }
-        
     entry.setAddress(reinterpret_cast<uint64_t>(page));
     entry.addFlags(PTE_PRESENT | PTE_WRITABLE);
     
@@ -49,132 +160,476 @@ PageTable* VMM::getTable(PageTableEntry& entry) {
     if (!entry.hasFlag(PTE_PRESENT)) {
         return nullptr;
     }
-    return reinterpret_cast<PageTable*>(entry.getAddress());
+    return reinterpret_cast<PageTable*>(entry.getAddress() + hhdm_request.response->offset);
 }
 
-bool VMM::map(void* virt, void* phys, uint64_t flags) {
+PageTable* VMM::splitEntry(PageTableEntry& entry, size_t entrySize) {
+    void* page = pmm.allocatePage();
+    if (!page) return nullptr;
+
+    PageTable* table = (PageTable*)((uint64_t)page + hhdm_request.response->offset);
+    size_t childSize = entrySize / 512;
+
+    uint64_t base = entry.getAddress() & ~(entrySize - 1);
+    uint64_t flags = entry.value & (0xFFF | PTE_NO_EXECUTE);
+    bool pat = entry.hasFlag(PTE_HUGE_PAT);
+
+    if (childSize == PAGE_SIZE) {
+        flags &= ~PTE_HUGE;
+        if (pat) flags |= PTE_HUGE;
+    }
+
+    for (int i = 0; i < 512; i++) {
+        table->entries[i].clear();
+        table->entries[i].setAddress(base + i * childSize);
+        table->entries[i].setFlags(flags);
+        if (pat && childSize != PAGE_SIZE) {
+            table->entries[i].addFlags(PTE_HUGE_PAT);
+        }
+    }
+
+    entry.clear();
+    entry.setAddress(reinterpret_cast<uint64_t>(page));
+    entry.setFlags(PTE_PRESENT | PTE_WRITABLE | (flags & PTE_USER));
+
+    return table;
+}
+
+void VMM::freeTable(PageTableEntry& entry, size_t level) {
+    PageTable* table = getTable(entry);
+    if (!table) return;
+
+    size_t childSize = getLevelSize(level + 1);
+
+    for (int i = 0; i < 512; i++) {
+        PageTableEntry& child = table->entries[i];
+        if (!child.hasFlag(PTE_PRESENT)) continue;
+
+        if (level + 1 == 3 || child.hasFlag(PTE_HUGE)) {
+            if (child.hasFlag(PTE_OWNED)) {
+                uint64_t phys = child.getAddress() & ~(childSize - 1);
+                pmm.freePages(reinterpret_cast<void*>(phys), childSize / PAGE_SIZE);
+            }
+        } else {
+            freeTable(child, level + 1);
+        }
+    }
+
+    pmm.freePage(reinterpret_cast<void*>(entry.getAddress()));
+}
+
+PageTable* VMM::getOrCreateLevel(uint64_t virt, size_t level, uint64_t flags) {
+    PageTable* table = _pml4;
+
+    for (size_t i = 0; i < level; i++) {
+        PageTableEntry& entry = table->entries[getIndex(virt, i)];
+
+        if (entry.hasFlag(PTE_PRESENT) && entry.hasFlag(PTE_HUGE)) {
+            table = splitEntry(entry, getLevelSize(i));
+        } else {
+            table = getOrCreateTable(entry);
+        }
+        if (!table) return nullptr;
+
+        if (flags & PTE_USER) {
+            entry.addFlags(PTE_USER);
+        }
+    }
+
+    return table;
+}
+
+PageTable* VMM::findLevel(uint64_t virt, size_t& level) {
+    PageTable* table = _pml4;
+
+    for (level = 0; level < 3; level++) {
+        PageTableEntry& entry = table->entries[getIndex(virt, level)];
+        if (!entry.hasFlag(PTE_PRESENT)) return nullptr;
+        if (level > 0 && entry.hasFlag(PTE_HUGE)) break;
+
+        table = getTable(entry);
+    }
+
+    return table;
+}
+
+size_t VMM::pickLevel(uint64_t virt, uint64_t phys, uint64_t remaining) {
+    if (((virt | phys) & (PAGE_SIZE_1G - 1)) == 0 && remaining >= PAGE_SIZE_1G && hasGigaPages()) {
+        return 1;
+    }
+    if (((virt | phys) & (PAGE_SIZE_2M - 1)) == 0 && remaining >= PAGE_SIZE_2M) {
+        return 2;
+    }
+    return 3;
+}
+
+bool VMM::hasGigaPages() {
+    static int supported = -1;
+
+    if (supported < 0) {
+        uint32_t eax = 0x80000001, ebx = 0, ecx = 0, edx = 0;
+        cpuid(&eax, &ebx, &ecx, &edx);
+        supported = (edx >> 26) & 1;
+    }
+    return supported;
+}
+
+bool VMM::isActive() const {
     if (!initialized) return false;
 
-    size_t pml4Index = getPML4Index(virt);
-    size_t pdptIndex = getPDPTIndex(virt);
-    size_t pdIndex = getPDIndex(virt);
-    size_t ptIndex = getPTIndex(virt);
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    return (cr3 & ~0xFFFULL) == reinterpret_cast<uint64_t>(_pml4) - hhdm_request.response->offset;
+}
 
-    PageTable* pdpt = getOrCreateTable(_pml4->entries[pml4Index]);
-    if (!pdpt) return false;
-    
-    if (flags & PTE_USER) {
-        _pml4->entries[pml4Index].addFlags(PTE_USER);
+void VMM::flushAll(bool global) {
+    if (global) {
+        uint64_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        if (cr4 & CR4_PGE) {
+            asm volatile("mov %0, %%cr4" :: "r"(cr4 & ~CR4_PGE) : "memory");
+            asm volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+            return;
+        }
     }
-        
-    PageTable* pd = getOrCreateTable(pdpt->entries[pdptIndex]);
-    if (!pd) return false;
-    
-    if (flags & PTE_USER) {
-        pdpt->entries[pdptIndex].addFlags(PTE_USER);
+
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %0, %%cr3" :: "r"(cr3) : "memory");
+}
+
+void VMM::flushRange(uint64_t start, uint64_t end) {
+    if (start >= end) return;
+
+    bool global = start >= VMM_KERNEL_HALF;
+    if (!global && !isActive()) {
+        stale = true;
+        return;
     }
-    
-    PageTable* pt = getOrCreateTable(pd->entries[pdIndex]);
-    if (!pt) return false;
-    
-    if (flags & PTE_USER) {
-        pd->entries[pdIndex].addFlags(PTE_USER);
+
+    if ((end - start) / PAGE_SIZE > TLB_FLUSH_THRESHOLD) {
+        flushAll(global);
+        return;
     }
-    
-    pt->entries[ptIndex].setAddress(reinterpret_cast<uint64_t>(phys));
-    pt->entries[ptIndex].setFlags(flags);
 
-    asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+    for (uint64_t virt = start; virt < end; virt += PAGE_SIZE) {
+        asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+    }
+}
 
-    return true;
+bool VMM::map(void* virt, void* phys, uint64_t flags) {
+    return mapRange(virt, phys, 1, flags);
 }
 
 bool VMM::mapRange(void* virt, void* phys, size_t count, uint64_t flags) {
-    uint64_t _virtual = reinterpret_cast<uint64_t>(virt);
+    if (!initialized) return false;
+
+    uint64_t start = reinterpret_cast<uint64_t>(virt);
+    uint64_t end = start + count * PAGE_SIZE;
+    uint64_t _virtual = start;
     uint64_t physical = reinterpret_cast<uint64_t>(phys);
 
-    for (size_t i = 0; i < count; i++) {
-        void* v = reinterpret_cast<void*>(_virtual + i * PAGE_SIZE);
-        void* p = reinterpret_cast<void*>(physical + i * PAGE_SIZE);
+    bool replaced = false;
+    bool success = true;
+
+    while (_virtual < end) {
+        size_t level = pickLevel(_virtual, physical, end - _virtual);
+        size_t pageSize = getLevelSize(level);
 
-        if (!map(v, p, flags)) {
-            return false;
+        PageTable* table = getOrCreateLevel(_virtual, level, flags);
+        if (!table) {
+            success = false;
+            break;
+        }
+
+        uint64_t entryFlags = flags;
+        if (pageSize > PAGE_SIZE) {
+            entryFlags |= PTE_HUGE;
+        } else if (flags & PTE_HUGE_PAT) {
+            entryFlags = (flags & ~PTE_HUGE_PAT) | PTE_PAT;
+        }
+        if (_virtual >= VMM_KERNEL_HALF) {
+            entryFlags |= PTE_GLOBAL;
+        }
+
+        for (size_t i = getIndex(_virtual, level); i < 512 && end - _virtual >= pageSize; i++) {
+            PageTableEntry& entry = table->entries[i];
+
+            if (entry.hasFlag(PTE_PRESENT)) {
+                if (pageSize > PAGE_SIZE && !entry.hasFlag(PTE_HUGE)) {
+                    freeTable(entry, level);
+                } else if (entry.hasFlag(PTE_OWNED) && (entry.getAddress() & ~(pageSize - 1)) != physical) {
+                    pmm.freePages(reinterpret_cast<void*>(entry.getAddress() & ~(pageSize - 1)), pageSize / PAGE_SIZE);
+                }
+                replaced = true;
+            }
+
+            entry.clear();
+            entry.setAddress(physical);
+            entry.setFlags(entryFlags);
+            if (pageSize > PAGE_SIZE && (flags & PTE_HUGE_PAT)) {
+                entry.addFlags(PTE_HUGE_PAT);
+            }
+
+            _virtual += pageSize;
+            physical += pageSize;
         }
     }
 
-    return true;
+    if (replaced) {
+        flushRange(start, _virtual);
+    }
+
+    return success;
 }
 
 bool VMM::unmap(void* virt) {
+    return unmapRange(virt, 1);
+}
+
+bool VMM::unmapRange(void* virt, size_t count) {
     if (!initialized) return false;
 
-    size_t pml4Index = getPML4Index(virt);
-    size_t pdptIndex = getPDPTIndex(virt);
-    size_t pdIndex = getPDIndex(virt);
-    size_t ptIndex = getPTIndex(virt);
+    uint64_t start = reinterpret_cast<uint64_t>(virt);
+    uint64_t end = start + count * PAGE_SIZE;
+    uint64_t _virtual = start;
+
+    bool success = true;
 
-    PageTable* pdpt = getTable(_pml4->entries[pml4Index]);
-    if (!pdpt) return false;
+    while (_virtual < end && success) {
+        size_t level;
+        PageTable* table = findLevel(_virtual, level);
+        if (!table) {
+            success = false;
+            break;
+        }
 
-    PageTable* pd = getTable(pdpt->entries[pdptIndex]);
-    if (!pd) return false;
+        size_t pageSize = getLevelSize(level);
+        size_t i = getIndex(_virtual, level);
 
-    PageTable* pt = getTable(pd->entries[pdIndex]);
-    if (!pt) return false;
+        if (pageSize > PAGE_SIZE && ((_virtual & (pageSize - 1)) || end - _virtual < pageSize)) {
+            success = splitEntry(table->entries[i], pageSize) != nullptr;
+            continue;
+        }
 
-    pt->entries[ptIndex].clear();
+        for (; i < 512 && end - _virtual >= pageSize; i++) {
+            PageTableEntry& entry = table->entries[i];
 
-    asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+            if (!entry.hasFlag(PTE_PRESENT)) {
+                success = false;
+                break;
+            }
+            if (pageSize > PAGE_SIZE && !entry.hasFlag(PTE_HUGE)) break;
 
-    return true;
+            entry.clear();
+            _virtual += pageSize;
+        }
+    }
+
+    flushRange(start, _virtual);
+
+    return success;
 }
 
-bool VMM::unmapRange(void* virt, size_t count) {
-    uint64_t _virtual = reinterpret_cast<uint64_t>(virt);
+size_t VMM::freeRange(void* virt, size_t count) {
+    if (!initialized) return 0;
+
+    uint64_t start = reinterpret_cast<uint64_t>(virt);
+    uint64_t end = start + count * PAGE_SIZE;
+    uint64_t _virtual = start;
+    size_t released = 0;
+
+    while (_virtual < end) {
+        size_t level;
+        PageTable* table = findLevel(_virtual, level);
+        size_t pageSize = getLevelSize(level);
+
+        if (!table) {
+            _virtual = (_virtual & ~(pageSize - 1)) + pageSize;
+            continue;
+        }
+
+        size_t i = getIndex(_virtual, level);
+
+        if (pageSize > PAGE_SIZE && ((_virtual & (pageSize - 1)) || end - _virtual < pageSize)) {
+            if (!splitEntry(table->entries[i], pageSize)) break;
+            continue;
+        }
+
+        for (; i < 512 && end - _virtual >= pageSize; i++) {
+            PageTableEntry& entry = table->entries[i];
 
-    for (size_t i = 0; i < count; i++) {
-        void* v = reinterpret_cast<void*>(_virtual + i * PAGE_SIZE);
-        if (!unmap(v)) {
-            return false;
+            if (entry.hasFlag(PTE_PRESENT)) {
+                if (pageSize > PAGE_SIZE && !entry.hasFlag(PTE_HUGE)) break;
+
+                if (entry.hasFlag(PTE_OWNED)) {
+                    uint64_t phys = entry.getAddress() & ~(pageSize - 1);
+                    pmm.freePages(reinterpret_cast<void*>(phys), pageSize / PAGE_SIZE);
+                    released += pageSize / PAGE_SIZE;
+                }
+                entry.clear();
+            }
+
+            _virtual += pageSize;
         }
     }
 
-    return true;
+    flushRange(start, _virtual < end ? _virtual : end);
+
+    return released;
 }
 
 void* VMM::getPhysical(void* virt) {
     if (!initialized) return nullptr;
 
-    size_t pml4Index = getPML4Index(virt);
-    size_t pdptIndex = getPDPTIndex(virt);
-    size_t pdIndex = getPDIndex(virt);
-    size_t ptIndex = getPTIndex(virt);
+    uint64_t _virtual = reinterpret_cast<uint64_t>(virt);
 
-    PageTable* pdpt = getTable(_pml4->entries[pml4Index]);
-    if (!pdpt) return nullptr;
+    size_t level;
+    PageTable* table = findLevel(_virtual, level);
+    if (!table) return nullptr;
 
-    PageTable* pd = getTable(pdpt->entries[pdptIndex]);
-    if (!pd) return nullptr;
+    PageTableEntry& entry = table->entries[getIndex(_virtual, level)];
+    if (!entry.hasFlag(PTE_PRESENT)) return nullptr;
 
-    PageTable* pt = getTable(pd->entries[pdIndex]);
-    if (!pt) return nullptr;
+    size_t pageSize = getLevelSize(level);
+    uint64_t phys = entry.getAddress() & ~(pageSize - 1);
 
-    if (!pt->entries[ptIndex].hasFlag(PTE_PRESENT)) {
-        return nullptr;
-    }
+    return reinterpret_cast<void*>(phys + (_virtual & (pageSize - 1)));
+}
 
-    uint64_t phys = pt->entries[ptIndex].getAddress();
-    uint64_t offset = reinterpret_cast<uint64_t>(virt) & 0xFFF;
+uint64_t VMM::getCR3() {
+    assignPCID();
 
-    return reinterpret_cast<void*>(phys + offset);
+    uint64_t pml4Virt = reinterpret_cast<uint64_t>(_pml4);
+    return (pml4Virt - hhdm_request.response->offset) | pcid;
 }
 
 void VMM::load() {
     if (!initialized) return;
 
-    uint64_t pml4Virt = reinterpret_cast<uint64_t>(_pml4);
-    uint64_t pml4Phys = pml4Virt - hhdm_request.response->offset;
-    asm volatile("mov %0, %%cr3" :: "r"(pml4Phys) : "memory");
+    uint64_t cr3 = getCR3();
+    if (pcid && !stale) {
+        cr3 |= CR3_NO_FLUSH;
+    }
+    stale = false;
+
+    asm volatile("mov %0, %%cr3" :: "r"(cr3) : "memory");
+}
+
+bool VMM::cloneTable(PageTableEntry& entry, PageTableEntry& copy, size_t level) {
+    PageTable* source = getTable(entry);
+    if (!source) return false;
+
+    void* page = pmm.allocateZeroedPage();
+    if (!page) return false;
+
+    PageTable* table = (PageTable*)((uint64_t)page + hhdm_request.response->offset);
+    copy.value = entry.value;
+    copy.setAddress(reinterpret_cast<uint64_t>(page));
+
+    for (size_t i = 0; i < 512; i++) {
+        PageTableEntry& child = source->entries[i];
+        if (!child.hasFlag(PTE_PRESENT)) continue;
+
+        bool leaf = level + 1 == 3 || child.hasFlag(PTE_HUGE);
+
+        if (leaf && level + 1 < 3 && child.hasFlag(PTE_OWNED)) {
+            if (!splitEntry(child, getLevelSize(level + 1))) return false;
+            leaf = false;
+        }
+
+        if (!leaf) {
+            if (!cloneTable(child, table->entries[i], level + 1)) return false;
+            continue;
+        }
+
+        if (child.hasFlag(PTE_OWNED)) {
+            if (!pmm.sharePage(reinterpret_cast<void*>(child.getAddress()))) return false;
+
+            if (child.hasFlag(PTE_WRITABLE) && !child.hasFlag(PTE_SHARED)) {
+                child.removeFlags(PTE_WRITABLE);
+                child.addFlags(PTE_COW);
+            }
+        }
+
+        table->entries[i] = child;
+    }
+
+    return true;
+}
+
+bool VMM::cloneInto(VMM& child) {
+    if (!initialized || !child.initialized) return false;
+
+    bool success = true;
+
+    for (size_t i = 0; i < 256 && success; i++) {
+        PageTableEntry& copy = child._pml4->entries[i];
+        if (copy.hasFlag(PTE_PRESENT)) {
+            child.freeTable(copy, 0);
+        }
+        copy.clear();
+
+        PageTableEntry& entry = _pml4->entries[i];
+        if (entry.hasFlag(PTE_PRESENT)) {
+            success = cloneTable(entry, copy, 0);
+        }
+    }
+
+    flushRange(0, VMM_KERNEL_HALF);
+    child.stale = true;
+
+    return success;
+}
+
+bool VMM::mergeInto(VMM& child) {
+    if (!initialized || !child.initialized) return false;
+
+    for (size_t i = 0; i < 256; i++) {
+        PageTableEntry& entry = _pml4->entries[i];
+        if (!entry.hasFlag(PTE_PRESENT)) continue;
+
+        PageTableEntry& copy = child._pml4->entries[i];
+        if (copy.hasFlag(PTE_PRESENT)) return false;
+        if (!cloneTable(entry, copy, 0)) return false;
+    }
+
+    child.stale = true;
+
+    return true;
+}
+
+bool VMM::resolveCopyOnWrite(void* virt) {
+    if (!initialized) return false;
+
+    uint64_t _virtual = reinterpret_cast<uint64_t>(virt) & ~(PAGE_SIZE - 1);
+
+    size_t level;
+    PageTable* table = findLevel(_virtual, level);
+    if (!table || level != 3) return false;
+
+    PageTableEntry& entry = table->entries[getIndex(_virtual, level)];
+    if (!entry.hasFlag(PTE_PRESENT) || !entry.hasFlag(PTE_COW)) return false;
+
+    void* frame = reinterpret_cast<void*>(entry.getAddress());
+
+    if (pmm.getShareCount(frame)) {
+        void* copy = pmm.allocatePage();
+        if (!copy) return false;
+
+        memcpy(reinterpret_cast<void*>((uint64_t)copy + hhdm_request.response->offset),
+               reinterpret_cast<void*>((uint64_t)frame + hhdm_request.response->offset), PAGE_SIZE);
+
+        pmm.freePage(frame);
+        entry.setAddress(reinterpret_cast<uint64_t>(copy));
+    }
+
+    entry.removeFlags(PTE_COW);
+    entry.addFlags(PTE_WRITABLE);
+
+    flushRange(_virtual, _virtual + PAGE_SIZE);
+
+    return true;
 }
 
 PageTable* VMM::getCurrentPageTable() {
@@ -184,15 +639,11 @@ PageTable* VMM::getCurrentPageTable() {
 }
 
 void VMM::cloneKernelMappings() {
-    if (!initialized) return;
-    
-    PageTable* kernelPML4 = getCurrentPageTable();
-    if (!kernelPML4) return;
+    if (!initialized || !vmm.isInitialized()) return;
     
-    uint64_t kernelPML4Phys = (uint64_t)kernelPML4 - hhdm_request.response->offset;
-    PageTable* kernelPML4Virt = (PageTable*)((uint64_t)kernelPML4Phys + hhdm_request.response->offset);
+    PageTable* kernelPML4 = vmm.getPageTable();
     
     for (int i = 256; i < 512; i++) {
-        _pml4->entries[i] = kernelPML4Virt->entries[i];
+        _pml4->entries[i] = kernelPML4->entries[i];
     }
-}
+}
\ No newline at end of file
@@ -13,23 +13,63 @@ constexpr uint64_t PTE_CACHE_DISABLE = (1ULL << 4);
 constexpr uint64_t PTE_ACCESSED = (1ULL << 5);
 constexpr uint64_t PTE_DIRTY = (1ULL << 6);
 constexpr uint64_t PTE_HUGE = (1ULL << 7);
+constexpr uint64_t PTE_PAT = (1ULL << 7);
 constexpr uint64_t PTE_GLOBAL = (1ULL << 8);
+constexpr uint64_t PTE_OWNED = (1ULL << 9);
+constexpr uint64_t PTE_COW = (1ULL << 10);
+constexpr uint64_t PTE_SHARED = (1ULL << 11);
+constexpr uint64_t PTE_HUGE_PAT = (1ULL << 12);
 constexpr uint64_t PTE_NO_EXECUTE = (1ULL << 63);
 
+constexpr uint64_t PF_PRESENT = (1ULL << 0);
+constexpr uint64_t PF_WRITE = (1ULL << 1);
+constexpr uint64_t PF_USER = (1ULL << 2);
+
+constexpr uint64_t VMM_KERNEL_HALF = 0xFFFF800000000000;
+constexpr size_t TLB_FLUSH_THRESHOLD = 32;
+
+constexpr uint64_t CR4_PGE = (1ULL << 7);
+constexpr uint64_t CR4_PCIDE = (1ULL << 17);
+constexpr uint64_t CR3_NO_FLUSH = (1ULL << 63);
+constexpr size_t PCID_COUNT = 4096;
+
+constexpr uint32_t MSR_PAT = 0x277;
+
+// PA0 WB, PA1 WC, PA2 UC-, PA3 UC, PA4 WB, PA5 WT, PA6 UC-, PA7 UC
+constexpr uint64_t PAT_VALUE = 0x0007040600070106ULL;
+
+enum class MemoryType {
+    WriteBack,
+    WriteCombining,
+    WriteThrough,
+    Uncached
+};
+
 class VMM {
 public:
     VMM();
     void init(PageTable* pml4 = nullptr);
+    void release();
+
+    static void setupTLB();
+    static void setupPAT();
+    static uint64_t typeFlags(MemoryType type);
 
     bool map(void* virt, void* phys, uint64_t flags = PTE_PRESENT | PTE_WRITABLE);
     bool mapRange(void* virt, void* phys, size_t count, uint64_t flags = PTE_PRESENT | PTE_WRITABLE);
     
     bool unmap(void* virt);    
     bool unmapRange(void* virt, size_t count);
+    size_t freeRange(void* virt, size_t count);
     
     void* getPhysical(void* virt);
+
+    bool cloneInto(VMM& child);
+    bool mergeInto(VMM& child);
+    bool resolveCopyOnWrite(void* virt);
     
     void load();
+    uint64_t getCR3();
     
     static PageTable* getCurrentPageTable();
     
@@ -37,18 +77,36 @@ public:
     
     PageTable* getPageTable() const { return _pml4; }
     bool isInitialized() const { return initialized; }
+    bool isActive() const;
+    uint16_t getPCID() const { return pcid; }
     
 private:
     PageTable* _pml4;
     bool initialized;
+    bool ownsRoot;
+    uint16_t pcid;
+    bool stale;
     
     PageTable* getOrCreateTable(PageTableEntry& entry);    
     PageTable* getTable(PageTableEntry& entry);
+    PageTable* splitEntry(PageTableEntry& entry, size_t entrySize);
+    void freeTable(PageTableEntry& entry, size_t level);
+    bool cloneTable(PageTableEntry& entry, PageTableEntry& copy, size_t level);
+
+    PageTable* getOrCreateLevel(uint64_t virt, size_t level, uint64_t flags);
+    PageTable* findLevel(uint64_t virt, size_t& level);
+    void flushRange(uint64_t start, uint64_t end);
+
+    static size_t pickLevel(uint64_t virt, uint64_t phys, uint64_t remaining);
+    void markGlobal(PageTable* table, size_t level);
+
+    void assignPCID();
+    static uint16_t allocatePCID();
+    static bool hasGigaPages();
+    static void flushAll(bool global = false);
     
-    static size_t getPML4Index(void* virt) { return (reinterpret_cast<uint64_t>(virt) >> 39) & 0x1FF; }
-    static size_t getPDPTIndex(void* virt) { return (reinterpret_cast<uint64_t>(virt) >> 30) & 0x1FF; }
-    static size_t getPDIndex(void* virt) { return (reinterpret_cast<uint64_t>(virt) >> 21) & 0x1FF; }
-    static size_t getPTIndex(void* virt) { return (reinterpret_cast<uint64_t>(virt) >> 12) & 0x1FF; }
+    static size_t getIndex(uint64_t virt, size_t level) { return (virt >> (39 - level * 9)) & 0x1FF; }
+    static size_t getLevelSize(size_t level) { return static_cast<size_t>(1) << (39 - level * 9); }
 };
 
 extern VMM vmm;
\ No newline at end of file
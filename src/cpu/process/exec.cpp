@@ -6,6 +6,7 @@
 #include <string.h>
 #include <fs/vfs/vfs.hpp>
 #include <fs/elf/elf.hpp>
+#include <fs/elf/imagecache.hpp>
 
 Process* ProcessExecutor::createKernelProcess(void (*entry)()) {
     uint32_t pid = Scheduler::get().allocatePID();
@@ -56,10 +57,14 @@ Process* ProcessExecutor::createUserProcessWithCode(void* code, size_t codeSize)
     if (codePhys) {
         uint64_t codeVirt = reinterpret_cast<uint64_t>(codePhys) + hhdm_request.response->offset;
         
-        memset(reinterpret_cast<void*>(codeVirt), 0, pages * PAGE_SIZE);
         memcpy(reinterpret_cast<void*>(codeVirt), code, codeSize);
+        memset(reinterpret_cast<void*>(codeVirt + codeSize), 0, pages * PAGE_SIZE - codeSize);
         
-        proc->getVMM()->mapRange(reinterpret_cast<void*>(USER_CODE_BASE), codePhys, pages, PTE_PRESENT | PTE_WRITABLE | PTE_USER);
+        proc->getVMM()->mapRange(reinterpret_cast<void*>(USER_CODE_BASE), codePhys, pages, PTE_PRESENT | PTE_WRITABLE | PTE_USER | PTE_OWNED);
+        if (!proc->addArea(USER_CODE_BASE, USER_CODE_BASE + pages * PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, VMAType::Image, pages)) {
+            delete proc;
+            return nullptr;
+        }
     }
     
     uint64_t userStack = proc->getUserStack();
@@ -82,7 +87,21 @@ Process* ProcessExecutor::createUserProcessWithCode(void* code, size_t codeSize)
     return proc;
 }
 
-Process* ProcessExecutor::loadUserBinary(const char* path) {
+CachedImage* ProcessExecutor::lookupImage(const char* path) {
+    FileDescriptor* fd = nullptr;
+    int result = VFS::get().open(path, 0, &fd);
+    
+    if (result != 0 || !fd) {
+        return nullptr;
+    }
+    
+    CachedImage* image = ImageCache::get().lookup(fd->getNode());
+    VFS::get().close(fd);
+    
+    return image;
+}
+
+const void* ProcessExecutor::readBinary(const char* path, size_t* size, bool* persistent) {
     FileDescriptor* fd = nullptr;
     int result = VFS::get().open(path, 0, &fd);
     
@@ -90,16 +109,27 @@ Process* ProcessExecutor::loadUserBinary(const char* path) {
         return nullptr;
     }
     
+    VNode* node = fd->getNode();
+    
+    if (node->ops->map) {
+        uint64_t mappedSize = 0;
+        const void* mapped = node->ops->map(node, &mappedSize);
+        if (mapped) {
+            VFS::get().close(fd);
+            *size = mappedSize;
+            *persistent = true;
+            return mapped;
+        }
+    }
+    
     FileStats stats;
-    if (fd->getNode()->ops->stat(fd->getNode(), &stats) != 0) {
+    if (node->ops->stat(node, &stats) != 0) {
         VFS::get().close(fd);
         return nullptr;
     }
     
-    size_t size = stats.size;
-    
-    void* buffer = new uint8_t[size];
-    if (VFS::get().read(fd, buffer, size) != static_cast<int64_t>(size)) {
+    void* buffer = new uint8_t[stats.size];
+    if (VFS::get().read(fd, buffer, stats.size) != static_cast<int64_t>(stats.size)) {
         delete[] static_cast<uint8_t*>(buffer);
         VFS::get().close(fd);
         return nullptr;
@@ -107,14 +137,36 @@ Process* ProcessExecutor::loadUserBinary(const char* path) {
     
     VFS::get().close(fd);
     
+    *size = stats.size;
+    *persistent = false;
+    return buffer;
+}
+
+void ProcessExecutor::releaseBinary(const void* data, bool persistent) {
+    if (!persistent) {
+        delete[] static_cast<const uint8_t*>(data);
+    }
+}
+
+Process* ProcessExecutor::loadUserBinary(const char* path) {
+    if (CachedImage* image = lookupImage(path)) {
+        Process* proc = ELFLoader::loadCachedImage(image);
+        if (proc) return proc;
+    }
+    
+    size_t size = 0;
+    bool persistent = false;
+    const void* data = readBinary(path, &size, &persistent);
+    if (!data) return nullptr;
+    
     Process* proc = nullptr;
-    if (ELFLoader::isValidELF(buffer, size)) {
-        proc = ELFLoader::loadELF(buffer, size);
+    if (ELFLoader::isValidELF(data, size)) {
+        proc = ELFLoader::loadELF(data, size, persistent);
     } else {
-        proc = createUserProcessWithCode(buffer, size);
+        proc = createUserProcessWithCode(const_cast<void*>(data), size);
     }
     
-    delete[] static_cast<uint8_t*>(buffer);
+    releaseBinary(data, persistent);
     
     return proc;
 }
@@ -190,38 +242,24 @@ Process* ProcessExecutor::createUserProcessWithArgs(void* code, size_t codeSize,
 }
 
 Process* ProcessExecutor::loadUserBinaryWithArgs(const char* path, int argc, const char** argv) {
-    FileDescriptor* fd = nullptr;
-    int result = VFS::get().open(path, 0, &fd);
-    
-    if (result != 0 || !fd) {
-        return nullptr;
-    }
-    
-    FileStats stats;
-    if (fd->getNode()->ops->stat(fd->getNode(), &stats) != 0) {
-        VFS::get().close(fd);
-        return nullptr;
+    if (CachedImage* image = lookupImage(path)) {
+        Process* proc = ELFLoader::loadCachedImageWithArgs(image, argc, argv);
+        if (proc) return proc;
     }
     
-    size_t size = stats.size;
-    
-    void* buffer = new uint8_t[size];
-    if (VFS::get().read(fd, buffer, size) != static_cast<int64_t>(size)) {
-        delete[] static_cast<uint8_t*>(buffer);
-        VFS::get().close(fd);
-        return nullptr;
-    }
-    
-    VFS::get().close(fd);
+    size_t size = 0;
+    bool persistent = false;
+    const void* data = readBinary(path, &size, &persistent);
+    if (!data) return nullptr;
     
     Process* proc = nullptr;
-    if (ELFLoader::isValidELF(buffer, size)) {
-        proc = ELFLoader::loadELFWithArgs(buffer, size, argc, argv);
+    if (ELFLoader::isValidELF(data, size)) {
+        proc = ELFLoader::loadELFWithArgs(data, size, argc, argv, persistent);
     } else {
-        proc = createUserProcessWithArgs(buffer, size, argc, argv);
+        proc = createUserProcessWithArgs(const_cast<void*>(data), size, argc, argv);
     }
     
-    delete[] static_cast<uint8_t*>(buffer);
+    releaseBinary(data, persistent);
     
     return proc;
 }
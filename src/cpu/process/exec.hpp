@@ -4,6 +4,7 @@
 #include "scheduler.hpp"
 
 class GDT;
+struct CachedImage;
 
 class ProcessExecutor {
 public:
@@ -18,4 +19,7 @@ public:
 private:
     static void kernelProcessWrapper();
     static void setupArguments(Process* proc, int argc, const char** argv);
+    static CachedImage* lookupImage(const char* path);
+    static const void* readBinary(const char* path, size_t* size, bool* persistent);
+    static void releaseBinary(const void* data, bool persistent);
 };
@@ -1,9 +1,11 @@
 #include "process.hpp"
 #include <cpu/mm/pmm.hpp>
+#include <cpu/mm/objcache.hpp>
 #include <x86_64/requests.hpp>
 #include <cpu/gdt/gdt.hpp>
 #include <cpu/syscall/syscall.hpp>
 #include <graphics/console.hpp>
+#include <string.h>
 
 extern Console* console;
 extern "C" void enterUsermode(uint64_t entry, uint64_t stack);
@@ -11,7 +13,17 @@ extern "C" void enterUsermode(uint64_t entry, uint64_t stack);
 constexpr uint64_t USER_STACK_TOP = 0x00007FFFFFFFE000;
 constexpr size_t USER_STACK_PAGES = 4;
 
-Process::Process(uint32_t pid) : pid(pid), parentPID(0), next(nullptr), exitCode(0), state(ProcessState::Ready), kernelStack(0), userStack(0), fpuState(nullptr), validUserState(false) {
+static ObjectCache<Process> processCache;
+
+void* Process::operator new(size_t) {
+    return processCache.allocate();
+}
+
+void Process::operator delete(void* ptr) {
+    processCache.free(ptr);
+}
+
+Process::Process(uint32_t pid, bool mapStack) : pid(pid), parentPID(0), next(nullptr), exitCode(0), state(ProcessState::Ready), kernelStack(0), userStack(0), fpuState(nullptr), validUserState(false) {
     for (int i = 0; i < NSIG; i++) {
         signalHandler.handlers[i] = nullptr;
     }
@@ -33,11 +45,15 @@ Process::Process(uint32_t pid) : pid(pid), parentPID(0), next(nullptr), exitCode
         }
     }
     
-    void* ustackPhys = pmm.allocatePages(USER_STACK_PAGES);
+    // Forked children receive their stack through cloneInto.
+    void* ustackPhys = mapStack ? pmm.allocatePages(USER_STACK_PAGES) : nullptr;
     if (ustackPhys) {
         uint64_t ustackBase = USER_STACK_TOP - (USER_STACK_PAGES * PAGE_SIZE);
-        vmm.mapRange(reinterpret_cast<void*>(ustackBase), ustackPhys, USER_STACK_PAGES, PTE_PRESENT | PTE_WRITABLE | PTE_USER);
-        userStack = USER_STACK_TOP - 8;    }
+        vmm.mapRange(reinterpret_cast<void*>(ustackBase), ustackPhys, USER_STACK_PAGES, PTE_PRESENT | PTE_WRITABLE | PTE_USER | PTE_OWNED);
+        if (addArea(ustackBase, USER_STACK_TOP, PROT_READ | PROT_WRITE, VMAType::Stack, USER_STACK_PAGES)) {
+            userStack = USER_STACK_TOP - 8;
+        }
+    }
     
     void* fpuPhys = pmm.allocatePage();
     if (fpuPhys) {
@@ -63,9 +79,7 @@ Process::Process(uint32_t pid) : pid(pid), parentPID(0), next(nullptr), exitCode
     context.rip = 0;
     context.rflags = 0x202;
     
-    uint64_t pml4Virt = reinterpret_cast<uint64_t>(vmm.getPageTable());
-    uint64_t pml4Phys = pml4Virt - hhdm_request.response->offset;
-    context.cr3 = pml4Phys;
+    context.cr3 = vmm.getCR3();
     
     context.fxstate = reinterpret_cast<uint64_t>(fpuState);
     
@@ -81,20 +95,13 @@ Process::~Process() {
         pmm.freePages(kstackPhys, 4);
     }
     
-    if (userStack) {
-        uint64_t ustackBase = USER_STACK_TOP - (USER_STACK_PAGES * PAGE_SIZE);
-        void* ustackVirt = reinterpret_cast<void*>(ustackBase);
-        void* ustackPhys = vmm.getPhysical(ustackVirt);
-        if (ustackPhys) {
-            vmm.unmapRange(ustackVirt, USER_STACK_PAGES);
-            pmm.freePages(ustackPhys, USER_STACK_PAGES);
-        }
-    }
-    
     if (fpuState) {
         void* fpuPhys = reinterpret_cast<void*>(reinterpret_cast<uint64_t>(fpuState) - hhdm_request.response->offset);
         pmm.freePage(fpuPhys);
     }
+
+    vmm.release();
+    vmas.destroy();
 }
 
 void Process::jumpToUsermode(uint64_t entry, GDT* gdt) {    
@@ -152,3 +159,220 @@ void Process::handlePendingSignals() {
         break;
     }
 }
+
+bool Process::addArea(uint64_t start, uint64_t end, uint32_t prot, VMAType type, size_t residentPages) {
+    uint64_t cursor = start;
+
+    while (cursor < end) {
+        VMA* overlap = vmas.find(cursor);
+
+        if (!overlap) {
+            size_t next = vmas.lowerBound(cursor);
+            uint64_t gapEnd = end;
+            if (next < vmas.getCount() && vmas.at(next).start < end) {
+                gapEnd = vmas.at(next).start;
+            }
+
+            if (!vmas.insert(cursor, gapEnd, prot, type)) return false;
+            cursor = gapEnd;
+            continue;
+        }
+
+        // Pages shared with an existing area (segments meeting mid-page) are
+        // split off so only they gain the extra protection.
+        uint64_t to = end < overlap->end ? end : overlap->end;
+        if ((overlap->prot | prot) != overlap->prot) {
+            if (!vmas.split(cursor) || !vmas.split(to)) return false;
+            vmas.find(cursor)->prot |= prot;
+        }
+
+        cursor = to;
+    }
+
+    vmas.addResident(residentPages);
+    return true;
+}
+
+bool Process::addImageArea(uint64_t start, uint64_t end, uint32_t prot, const uint8_t* source, uint64_t sourceSize) {
+    VMA* area = vmas.insert(start, end, prot, VMAType::Image, VMA_DEMAND);
+    if (!area) return false;
+
+    area->source = source;
+    area->sourceSize = sourceSize;
+    return true;
+}
+
+uint64_t Process::mapAnonymous(uint64_t addr, size_t length, uint32_t prot) {
+    if (length == 0) return 0;
+
+    uint64_t size = (length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (size > MMAP_END - MMAP_BASE) return 0;
+
+    uint64_t start = addr;
+    bool hinted = !(addr & (PAGE_SIZE - 1)) && addr >= MMAP_BASE &&
+                  addr <= MMAP_END - size && vmas.isFree(addr, addr + size);
+
+    if (!hinted) {
+        start = vmas.findFree(size, MMAP_BASE, MMAP_END);
+        if (!start) return 0;
+    }
+
+    if (!prot) prot = PROT_READ | PROT_WRITE;
+    if (!vmas.insert(start, start + size, prot, VMAType::Anonymous, VMA_DEMAND)) return 0;
+
+    return start;
+}
+
+uint64_t Process::mapShared(SharedSegment* segment, uint32_t prot) {
+    uint64_t size = segment->pageCount * PAGE_SIZE;
+
+    uint64_t start = vmas.findFree(size, MMAP_BASE, MMAP_END);
+    if (!start) return 0;
+
+    if (!prot) prot = PROT_READ | PROT_WRITE;
+    if (!vmas.insert(start, start + size, prot, VMAType::Shared)) return 0;
+
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_OWNED | PTE_SHARED;
+    if (prot & PROT_WRITE) {
+        flags |= PTE_WRITABLE;
+    }
+
+    for (size_t i = 0; i < segment->pageCount; i++) {
+        void* frame = segment->frames[i];
+        void* page = reinterpret_cast<void*>(start + i * PAGE_SIZE);
+
+        if (!pmm.sharePage(frame)) {
+            unmapArea(start, size);
+            return 0;
+        }
+
+        if (!vmm.map(page, frame, flags)) {
+            pmm.freePage(frame);
+            unmapArea(start, size);
+            return 0;
+        }
+
+        vmas.addResident(1);
+    }
+
+    return start;
+}
+
+bool Process::unmapArea(uint64_t addr, size_t length) {
+    if ((addr & (PAGE_SIZE - 1)) || length == 0) return false;
+
+    uint64_t start = addr;
+    uint64_t end = (addr + length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (end < start || end > USER_SPACE_END) return false;
+
+    for (size_t i = vmas.lowerBound(start); i < vmas.getCount() && vmas.at(i).start < end; i++) {
+        VMA& area = vmas.at(i);
+
+        uint64_t from = start > area.start ? start : area.start;
+        uint64_t to = end < area.end ? end : area.end;
+        vmas.removeResident(vmm.freeRange(reinterpret_cast<void*>(from), (to - from) / PAGE_SIZE));
+    }
+
+    return vmas.remove(start, end);
+}
+
+bool Process::handlePageFault(uint64_t addr, uint64_t errorCode) {
+    VMA* area = vmas.find(addr);
+    if (!area) return false;
+    if ((errorCode & PF_WRITE) && !(area->prot & PROT_WRITE)) return false;
+
+    if (errorCode & PF_PRESENT) {
+        if (!(errorCode & PF_WRITE)) return false;
+        return vmm.resolveCopyOnWrite(reinterpret_cast<void*>(addr));
+    }
+
+    if (!(area->flags & VMA_DEMAND)) return false;
+    if (area->source) return populateImagePage(area, addr & ~(PAGE_SIZE - 1));
+
+    void* frame = pmm.allocateZeroedPage();
+    if (!frame) return false;
+
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_OWNED;
+    if (area->prot & PROT_WRITE) {
+        flags |= PTE_WRITABLE;
+    }
+
+    void* page = reinterpret_cast<void*>(addr & ~(PAGE_SIZE - 1));
+    if (!vmm.map(page, frame, flags)) {
+        pmm.freePage(frame);
+        return false;
+    }
+
+    vmas.addResident(1);
+    return true;
+}
+
+bool Process::populateImagePage(VMA* area, uint64_t page) {
+    uint64_t offset = page - area->start;
+    uint64_t source = reinterpret_cast<uint64_t>(area->source) + offset;
+
+    if (!(area->prot & PROT_WRITE) && offset + PAGE_SIZE <= area->sourceSize &&
+        !(source & (PAGE_SIZE - 1))) {
+        void* frame = reinterpret_cast<void*>(source - hhdm_request.response->offset);
+        return vmm.map(reinterpret_cast<void*>(page), frame, PTE_PRESENT | PTE_USER);
+    }
+
+    void* frame = pmm.allocateZeroedPage();
+    if (!frame) return false;
+
+    if (offset < area->sourceSize) {
+        uint64_t length = area->sourceSize - offset;
+        if (length > PAGE_SIZE) length = PAGE_SIZE;
+
+        memcpy(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(frame) + hhdm_request.response->offset),
+               reinterpret_cast<const void*>(source), length);
+    }
+
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_OWNED;
+    if (area->prot & PROT_WRITE) {
+        flags |= PTE_WRITABLE;
+    }
+
+    if (!vmm.map(reinterpret_cast<void*>(page), frame, flags)) {
+        pmm.freePage(frame);
+        return false;
+    }
+
+    vmas.addResident(1);
+    return true;
+}
+
+Process* Process::fork(uint32_t childPid) {
+    Process* child = new Process(childPid, false);
+    if (!child) return nullptr;
+
+    if (!child->kernelStack || !vmm.cloneInto(child->vmm)) {
+        delete child;
+        return nullptr;
+    }
+
+    uint64_t cr3 = child->context.cr3;
+    uint64_t fxstate = child->context.fxstate;
+    child->context = context;
+    child->context.cr3 = cr3;
+    child->context.fxstate = fxstate;
+    child->context.rax = 0;
+
+    if (fpuState && child->fpuState) {
+        memcpy(child->fpuState, fpuState, sizeof(FPUState));
+    }
+
+    child->parentPID = pid;
+    child->userStack = userStack;
+    child->signalHandler = signalHandler;
+    child->signalHandler.pending = 0;
+
+    if (!child->vmas.copyFrom(vmas)) {
+        delete child;
+        return nullptr;
+    }
+
+    child->validUserState = true;
+
+    return child;
+}
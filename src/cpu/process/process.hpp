@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <cpu/mm/vmm.hpp>
+#include <cpu/mm/vma.hpp>
+#include <cpu/mm/shm.hpp>
 
 enum class ProcessState {
     Ready,
@@ -28,6 +30,10 @@ struct ProcessContext {
 
 typedef void (*sighandler_t)(int);
 
+constexpr uint64_t MMAP_BASE = 0x0000600000000000;
+constexpr uint64_t MMAP_END = 0x0000700000000000;
+constexpr uint64_t USER_SPACE_END = 0x0000800000000000;
+
 struct SignalHandler {
     sighandler_t handlers[NSIG];
     uint64_t pending;
@@ -39,9 +45,12 @@ class GDT;
 
 class Process {
 public:
-    Process(uint32_t pid);
+    Process(uint32_t pid, bool mapStack = true);
     ~Process();
     
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    
     uint32_t getPID() const { return pid; }
     ProcessState getState() const { return state; }
     void setState(ProcessState s) { state = s; }
@@ -72,6 +81,18 @@ public:
     SignalHandler* getSignalHandler() { return &signalHandler; }
     void sendSignal(int sig);
     void handlePendingSignals();
+
+    VMAList* getVMAs() { return &vmas; }
+    size_t getResidentPages() const { return vmas.getResidentPages(); }
+
+    bool addArea(uint64_t start, uint64_t end, uint32_t prot, VMAType type, size_t residentPages);
+    bool addImageArea(uint64_t start, uint64_t end, uint32_t prot, const uint8_t* source, uint64_t sourceSize);
+    uint64_t mapAnonymous(uint64_t addr, size_t length, uint32_t prot);
+    uint64_t mapShared(SharedSegment* segment, uint32_t prot);
+    bool unmapArea(uint64_t addr, size_t length);
+    bool handlePageFault(uint64_t addr, uint64_t errorCode);
+
+    Process* fork(uint32_t childPid);
     
 private:
     uint32_t pid;
@@ -85,4 +106,7 @@ private:
     VMM vmm;
     bool validUserState;
     SignalHandler signalHandler;
+    VMAList vmas;
+
+    bool populateImagePage(VMA* area, uint64_t page);
 };
@@ -3,6 +3,7 @@
 #include <graphics/console.hpp>
 #include <cpu/syscall/syscall.hpp>
 #include <cpu/idt/interrupt.hpp>
+#include <cpu/mm/heapprof.hpp>
 
 extern GDT* globalGDT;
 
@@ -61,6 +62,10 @@ void Scheduler::removeProcess(uint32_t pid) {
     if (toDelete) {
         if (currentProcess == toDelete) currentProcess = nullptr;
         delete toDelete;
+
+#ifdef KHEAP_PROFILE
+        heapProfiler.reportLeaks(pid);
+#endif
     }
 }
 
@@ -204,8 +209,7 @@ void Scheduler::schedule(InterruptFrame* frame) {
         
         Syscall::get().setKernelStack(nextProcess->getKernelStack());
         
-        uint64_t newCR3 = nextProcess->getContext()->cr3;
-        asm volatile("mov %0, %%cr3" :: "r"(newCR3) : "memory");
+        nextProcess->getVMM()->load();
         
         nextProcess->setState(ProcessState::Running);
         currentProcess = nextProcess;
@@ -41,13 +41,13 @@ syscallEntry:
     pop rbx
     pop rax
     
+    mov r8, rsi
+    mov r9, rdi
     mov rdi, rax
     mov rsi, rbx
     mov r10, rcx
     mov rcx, rdx
     mov rdx, r10
-    xor r8, r8
-    xor r9, r9
     
     call syscallHandler
     
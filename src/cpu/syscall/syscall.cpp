@@ -2,6 +2,8 @@
 #include <cpu/gdt/gdt.hpp>
 #include <cpu/process/scheduler.hpp>
 #include <cpu/process/exec.hpp>
+#include <cpu/mm/shm.hpp>
+#include <fs/elf/imagecache.hpp>
 #include <fs/vfs/vfs.hpp>
 #include <graphics/console.hpp>
 #include <interrupts/keyboard.hpp>
@@ -71,7 +73,7 @@ uint64_t Syscall::handle(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uin
         case Kill:
             return sys_kill(arg1, arg2);
         case Mmap:
-            return sys_mmap(arg1, arg2, arg3);
+            return sys_mmap(arg1, arg2, arg3, arg4, arg5);
         case Munmap:
             return sys_munmap(arg1, arg2);
         case Yield:
@@ -90,6 +92,18 @@ uint64_t Syscall::handle(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uin
             return sys_signal(arg1, arg2);
         case SigReturn:
             return sys_sigreturn();
+        case ShmCreate:
+            return sys_shm_create(arg1, arg2);
+        case ShmOpen:
+            return sys_shm_open(arg1, arg2);
+        case ShmMap:
+            return sys_shm_map(arg1, arg2);
+        case ShmUnmap:
+            return sys_shm_unmap(arg1);
+        case ShmUnlink:
+            return sys_shm_unlink(arg1);
+        case ExecStats:
+            return sys_exec_stats(arg1);
         default:
             return (uint64_t)-1;
     }
@@ -107,6 +121,16 @@ uint64_t Syscall::sys_exit(uint64_t code) {
     return 0;
 }
 
+static void idle() {
+    asm volatile("cli");
+    bool zeroed = pmm.zeroIdlePage();
+    asm volatile("sti");
+
+    if (!zeroed) {
+        asm volatile("pause");
+    }
+}
+
 static bool isValidUserPointer(uint64_t ptr, size_t size) {
     if (ptr >= 0xFFFF800000000000) {
         return false;
@@ -169,7 +193,7 @@ uint64_t Syscall::sys_read(uint64_t fd, uint64_t buf, uint64_t count) {
             char c = globalKeyboard->poll();
             
             if (c == 0) {
-                asm volatile("pause");
+                idle();
                 continue;
             }
             
@@ -219,7 +243,15 @@ uint64_t Syscall::sys_getpid() {
 }
 
 uint64_t Syscall::sys_fork() {
-    return -1;
+    Process* current = Scheduler::get().getCurrentProcess();
+    if (!current) return -1;
+
+    Process* child = current->fork(Scheduler::get().allocatePID());
+    if (!child) return -1;
+
+    Scheduler::get().addProcess(child);
+
+    return child->getPID();
 }
 
 uint64_t Syscall::sys_exec(uint64_t path, uint64_t argv, uint64_t envp __attribute__((unused))) {
@@ -324,12 +356,117 @@ uint64_t Syscall::sys_kill(uint64_t pid, uint64_t sig) {
     return 0;
 }
 
-uint64_t Syscall::sys_mmap(uint64_t addr, uint64_t length, uint64_t prot) {
-    return -1;
+uint64_t Syscall::sys_mmap(uint64_t addr, uint64_t length, uint64_t prot, uint64_t flags, uint64_t fd) {
+    Process* current = Scheduler::get().getCurrentProcess();
+    if (!current) return -1;
+
+    // Only private anonymous memory is supported; file and shared mappings go
+    // through the shm syscalls.
+    if (!(flags & MAP_ANONYMOUS) || (flags & MAP_SHARED) || static_cast<int64_t>(fd) != -1) {
+        return -1;
+    }
+
+    uint64_t mapped = current->mapAnonymous(addr, length, static_cast<uint32_t>(prot));
+    if (!mapped) return -1;
+
+    return mapped;
 }
 
 uint64_t Syscall::sys_munmap(uint64_t addr, uint64_t length) {
-    return -1;
+    Process* current = Scheduler::get().getCurrentProcess();
+    if (!current) return -1;
+
+    if (!current->unmapArea(addr, length)) return -1;
+
+    return 0;
+}
+
+static bool copyNameFromUser(uint64_t ptr, char* dest, size_t size) {
+    if (!isValidUserPointer(ptr, 1)) return false;
+
+    // Never read past the end of user space looking for the terminator.
+    if (size > USER_SPACE_END - ptr) {
+        size = USER_SPACE_END - ptr;
+    }
+
+    const char* src = reinterpret_cast<const char*>(ptr);
+    for (size_t i = 0; i < size; i++) {
+        dest[i] = src[i];
+        if (!dest[i]) return true;
+    }
+
+    return false;
+}
+
+uint64_t Syscall::sys_shm_create(uint64_t name, uint64_t size) {
+    char kernelName[SHM_NAME_LENGTH];
+    if (!copyNameFromUser(name, kernelName, sizeof(kernelName))) return -1;
+
+    return SharedMemory::get().create(kernelName, size);
+}
+
+uint64_t Syscall::sys_shm_open(uint64_t name, uint64_t size_ptr) {
+    char kernelName[SHM_NAME_LENGTH];
+    if (!copyNameFromUser(name, kernelName, sizeof(kernelName))) return -1;
+
+    int64_t id = SharedMemory::get().open(kernelName);
+    if (id < 0) return -1;
+
+    if (size_ptr) {
+        if (!isValidUserPointer(size_ptr, sizeof(uint64_t))) return -1;
+        *reinterpret_cast<uint64_t*>(size_ptr) = SharedMemory::get().getSegment(id)->pageCount * PAGE_SIZE;
+    }
+
+    return id;
+}
+
+uint64_t Syscall::sys_shm_map(uint64_t id, uint64_t prot) {
+    Process* current = Scheduler::get().getCurrentProcess();
+    if (!current) return -1;
+
+    SharedSegment* segment = SharedMemory::get().getSegment(static_cast<int64_t>(id));
+    if (!segment) return -1;
+
+    uint64_t mapped = current->mapShared(segment, static_cast<uint32_t>(prot));
+    if (!mapped) return -1;
+
+    return mapped;
+}
+
+uint64_t Syscall::sys_shm_unmap(uint64_t addr) {
+    Process* current = Scheduler::get().getCurrentProcess();
+    if (!current) return -1;
+
+    VMA* area = current->getVMAs()->find(addr);
+    if (!area || area->type != VMAType::Shared) return -1;
+
+    if (!current->unmapArea(area->start, area->end - area->start)) return -1;
+
+    return 0;
+}
+
+uint64_t Syscall::sys_shm_unlink(uint64_t name) {
+    char kernelName[SHM_NAME_LENGTH];
+    if (!copyNameFromUser(name, kernelName, sizeof(kernelName))) return -1;
+
+    if (!SharedMemory::get().unlink(kernelName)) return -1;
+
+    return 0;
+}
+
+uint64_t Syscall::sys_exec_stats(uint64_t stats_ptr) {
+    if (!isValidUserPointer(stats_ptr, sizeof(ExecStats))) {
+        return (uint64_t)-1;
+    }
+
+    ImageCache& cache = ImageCache::get();
+
+    ExecStats* stats = reinterpret_cast<ExecStats*>(stats_ptr);
+    stats->images = cache.getCount();
+    stats->hits = cache.getHits();
+    stats->misses = cache.getMisses();
+
+    return 0;
 }
 
 uint64_t Syscall::sys_yield() {
@@ -347,7 +484,7 @@ uint64_t Syscall::sys_sleep(uint64_t ms) {
     
     if (ms < 10) {
         while (globalTimer->getMilliseconds() < target) {
-            asm volatile("pause");
+            idle();
         }
         asm volatile("cli");
         return 0;
@@ -359,7 +496,7 @@ uint64_t Syscall::sys_sleep(uint64_t ms) {
             Scheduler::get().yield();
         }
         
-        asm volatile("pause");
+        idle();
     }
     asm volatile("cli");
     return 0;
@@ -418,8 +555,12 @@ uint64_t Syscall::sys_fb_info(uint64_t info_ptr) {
         reinterpret_cast<void*>(USER_FB_BASE),
         reinterpret_cast<void*>(fb_phys),
         pages,
-        PTE_PRESENT | PTE_WRITABLE | PTE_USER | PTE_CACHE_DISABLE
+        PTE_PRESENT | PTE_WRITABLE | PTE_USER | VMM::typeFlags(MemoryType::WriteCombining)
     );
+    if (!current->addArea(USER_FB_BASE, USER_FB_BASE + pages * PAGE_SIZE, PROT_READ | PROT_WRITE, VMAType::Framebuffer, 0)) {
+        current->getVMM()->unmapRange(reinterpret_cast<void*>(USER_FB_BASE), pages);
+        return (uint64_t)-1;
+    }
 
     
     FBInfo kernel_info;
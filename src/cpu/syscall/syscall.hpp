@@ -9,6 +9,12 @@ struct OSInfo {
     char usedRamGB[8];
 };
 
+struct ExecStats {
+    uint64_t images;
+    uint64_t hits;
+    uint64_t misses;
+};
+
 enum class SyscallNumber : uint64_t {
     OSInfo,
     ProcInfo,
@@ -31,7 +37,13 @@ enum class SyscallNumber : uint64_t {
     FBInfo,
     FBMap,
     Signal,
-    SigReturn
+    SigReturn,
+    ShmCreate,
+    ShmOpen,
+    ShmMap,
+    ShmUnmap,
+    ShmUnlink,
+    ExecStats
 };
 
 struct SyscallFrame {
@@ -75,7 +87,7 @@ private:
     uint64_t sys_exec(uint64_t path, uint64_t argv, uint64_t envp);
     uint64_t sys_wait(uint64_t pid, uint64_t status);
     uint64_t sys_kill(uint64_t pid, uint64_t sig);
-    uint64_t sys_mmap(uint64_t addr, uint64_t length, uint64_t prot);
+    uint64_t sys_mmap(uint64_t addr, uint64_t length, uint64_t prot, uint64_t flags, uint64_t fd);
     uint64_t sys_munmap(uint64_t addr, uint64_t length);
     uint64_t sys_yield();
     uint64_t sys_sleep(uint64_t ms);
@@ -86,6 +98,12 @@ private:
     uint64_t sys_signal(uint64_t sig, uint64_t handler);
     uint64_t sys_sigreturn();
     uint64_t sys_osinfo(uint64_t info_ptr);
+    uint64_t sys_shm_create(uint64_t name, uint64_t size);
+    uint64_t sys_shm_open(uint64_t name, uint64_t size_ptr);
+    uint64_t sys_shm_map(uint64_t id, uint64_t prot);
+    uint64_t sys_shm_unmap(uint64_t addr);
+    uint64_t sys_shm_unlink(uint64_t name);
+    uint64_t sys_exec_stats(uint64_t stats_ptr);
 };
 
 extern "C" void syscallEntry();
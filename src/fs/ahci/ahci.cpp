@@ -9,7 +9,7 @@ extern Heap kheap;
 extern PMM pmm;
 extern VMM vmm;
 
-AHCIPort::AHCIPort(HBAPort* port, int portNum) : port(port), portNum(portNum), active(false), sectorCount(0) {
+AHCIPort::AHCIPort(HBAPort* port, int portNum, uint32_t dmaZones) : port(port), portNum(portNum), dmaZones(dmaZones), active(false), sectorCount(0) {
 }
 
 int AHCIPort::getType() {
@@ -66,23 +66,15 @@ int AHCIPort::findCmdSlot() {
 bool AHCIPort::initialize() {
     stopCmd();
     
-    void* clbPhys = pmm.allocatePage();
+    void* clbPhys = pmm.allocateZeroedPage(dmaZones);
     if (!clbPhys) return false;
     uint64_t clbVirt = (uint64_t)clbPhys + hhdm_request.response->offset;
     
-    void* fbPhys = pmm.allocatePage();
+    void* fbPhys = pmm.allocateZeroedPage(dmaZones);
     if (!fbPhys) {
         pmm.freePage(clbPhys);
         return false;
     }
-    uint64_t fbVirt = (uint64_t)fbPhys + hhdm_request.response->offset;
-    
-    for (int i = 0; i < 1024; i++) {
-        ((uint8_t*)clbVirt)[i] = 0;
-    }
-    for (int i = 0; i < 256; i++) {
-        ((uint8_t*)fbVirt)[i] = 0;
-    }
     
     port->clb = (uint64_t)clbPhys & 0xFFFFFFFF;
     port->clbu = ((uint64_t)clbPhys >> 32) & 0xFFFFFFFF;
@@ -93,13 +85,8 @@ bool AHCIPort::initialize() {
     for (int i = 0; i < 32; i++) {
         cmdheader[i].prdtl = 8;
         
-        void* ctbPhys = pmm.allocatePage();
+        void* ctbPhys = pmm.allocateZeroedPage(dmaZones);
         if (!ctbPhys) continue;
-        uint64_t ctbVirt = (uint64_t)ctbPhys + hhdm_request.response->offset;
-        
-        for (int j = 0; j < 256; j++) {
-            ((uint8_t*)ctbVirt)[j] = 0;
-        }
         
         cmdheader[i].ctba = (uint64_t)ctbPhys & 0xFFFFFFFF;
         cmdheader[i].ctbau = ((uint64_t)ctbPhys >> 32) & 0xFFFFFFFF;
@@ -230,16 +217,17 @@ bool AHCIController::initialize() {
     for (size_t i = 0; i < pages_needed; i++) {
         void* phys = (void*)(abar_aligned + i * 4096);
         void* virt = (void*)(abar_aligned + i * 4096 + hhdm_offset);
-        vmm.map(virt, phys, PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE);
+        vmm.map(virt, phys, PTE_PRESENT | PTE_WRITABLE | VMM::typeFlags(MemoryType::Uncached));
     }
     
     hba = (HBAMemory*)(abar + hhdm_offset);
     
     uint32_t pi = hba->pi;
+    uint32_t dmaZones = (hba->cap & HBA_CAP_S64A) ? ZONE_ANY : (ZONE_DMA | ZONE_DMA32);
     
     for (int i = 0; i < 32; i++) {
         if (pi & 1) {
-            AHCIPort* port = new AHCIPort(&hba->ports[i], i);
+            AHCIPort* port = new AHCIPort(&hba->ports[i], i, dmaZones);
             int type = port->getType();
             
             if (type == AHCI_DEV_SATA) {
@@ -26,6 +26,8 @@
 
 #define HBA_PxIS_TFES (1 << 30)
 
+#define HBA_CAP_S64A (1u << 31)
+
 struct HBAPort {
     uint32_t clb;
     uint32_t clbu;
@@ -122,7 +124,7 @@ struct FISRegH2D {
 
 class AHCIPort {
 public:
-    AHCIPort(HBAPort* port, int portNum);
+    AHCIPort(HBAPort* port, int portNum, uint32_t dmaZones);
     
     bool initialize();
     bool read(uint64_t sector, uint32_t count, void* buffer);
@@ -136,6 +138,7 @@ public:
 private:
     HBAPort* port;
     int portNum;
+    uint32_t dmaZones;
     bool active;
     uint64_t sectorCount;
     
@@ -1,4 +1,5 @@
 #include "elf.hpp"
+#include "imagecache.hpp"
 #include <cpu/process/process.hpp>
 #include <cpu/process/scheduler.hpp>
 #include <cpu/mm/pmm.hpp>
@@ -46,63 +47,95 @@ bool ELFLoader::isValidELF(const void* data, size_t size) {
     return validateHeader(ehdr);
 }
 
-Process* ELFLoader::loadELF(const void* data, size_t size) {
+bool ELFLoader::parse(const void* data, size_t size, ELFImage* image) {
     if (!isValidELF(data, size)) {
-        return nullptr;
+        return false;
     }
     
     const Elf64_Ehdr* ehdr = static_cast<const Elf64_Ehdr*>(data);
-    
-    uint32_t pid = Scheduler::get().allocatePID();
-    Process* proc = new Process(pid);
+    if (ehdr->e_phoff > size || ehdr->e_phnum * sizeof(Elf64_Phdr) > size - ehdr->e_phoff) {
+        return false;
+    }
     
     const uint8_t* fileData = static_cast<const uint8_t*>(data);
     const Elf64_Phdr* phdr = reinterpret_cast<const Elf64_Phdr*>(fileData + ehdr->e_phoff);
     
+    image->entry = ehdr->e_entry;
+    image->segmentCount = 0;
+    
     for (uint16_t i = 0; i < ehdr->e_phnum; i++) {
-        if (phdr[i].p_type == PT_LOAD) {
-            uint64_t vaddr = phdr[i].p_vaddr;
-            uint64_t memsz = phdr[i].p_memsz;
-            uint64_t filesz = phdr[i].p_filesz;
-            uint64_t offset = phdr[i].p_offset;
+        if (phdr[i].p_type != PT_LOAD || phdr[i].p_memsz == 0) continue;
+        
+        uint64_t vaddr = phdr[i].p_vaddr;
+        uint64_t memsz = phdr[i].p_memsz;
+        uint64_t filesz = phdr[i].p_filesz;
+        uint64_t offset = phdr[i].p_offset;
+        
+        uint64_t pageAlignedAddr = vaddr & ~0xFFFULL;
+        uint64_t endAddr = vaddr + memsz;
+        uint64_t pageAlignedEnd = (endAddr + 0xFFF) & ~0xFFFULL;
+        uint64_t copyOffset = vaddr - pageAlignedAddr;
+        
+        if (offset > size || filesz > size - offset || filesz > memsz || offset < copyOffset ||
+            endAddr < vaddr || endAddr > USER_SPACE_END) {
+            return false;
+        }
+        
+        if (image->segmentCount == ELF_MAX_SEGMENTS) {
+            return false;
+        }
+        
+        ELFSegment& segment = image->segments[image->segmentCount++];
+        segment.start = pageAlignedAddr;
+        segment.end = pageAlignedEnd;
+        segment.offset = offset - copyOffset;
+        segment.fileSize = copyOffset + filesz;
+        
+        segment.prot = PROT_READ;
+        if (phdr[i].p_flags & PF_W) segment.prot |= PROT_WRITE;
+        if (phdr[i].p_flags & PF_X) segment.prot |= PROT_EXEC;
+    }
+    
+    return true;
+}
 
-            uint64_t pageAlignedAddr = vaddr & ~0xFFFULL;
-            uint64_t endAddr = vaddr + memsz;
-            uint64_t pageAlignedEnd = (endAddr + 0xFFF) & ~0xFFFULL;
-            size_t pages = (pageAlignedEnd - pageAlignedAddr) / PAGE_SIZE;
-            
-            void* physPages = pmm.allocatePages(pages);
-            if (!physPages) {
-                if (console) {
-                    console->drawText("[ELF] Failed to allocate pages\n");
-                }
-                delete proc;
-                return nullptr;
-            }
-            
-            uint64_t virtPages = reinterpret_cast<uint64_t>(physPages) + hhdm_request.response->offset;
-            memset(reinterpret_cast<void*>(virtPages), 0, pages * PAGE_SIZE);
-            
-            if (filesz > 0) {
-                uint64_t copyOffset = vaddr - pageAlignedAddr;
-                memcpy(reinterpret_cast<void*>(virtPages + copyOffset), 
-                       fileData + offset, filesz);
-            }
-            
-            uint64_t flags = PTE_PRESENT | PTE_USER;
-            if (phdr[i].p_flags & PF_W) {
-                flags |= PTE_WRITABLE;
-            }
-            
-            proc->getVMM()->mapRange(reinterpret_cast<void*>(pageAlignedAddr), 
-                                     physPages, pages, flags);
+bool ELFLoader::mapSegment(Process* proc, const ELFSegment& segment, const uint8_t* fileData, bool persistent) {
+    if (persistent && proc->addImageArea(segment.start, segment.end, segment.prot,
+                                         fileData + segment.offset, segment.fileSize)) {
+        return true;
+    }
+    
+    size_t pages = (segment.end - segment.start) / PAGE_SIZE;
+    
+    void* physPages = pmm.allocatePages(pages);
+    if (!physPages) {
+        if (console) {
+            console->drawText("[ELF] Failed to allocate pages\n");
         }
+        return false;
+    }
+    
+    uint64_t virtPages = reinterpret_cast<uint64_t>(physPages) + hhdm_request.response->offset;
+    
+    if (segment.fileSize > 0) {
+        memcpy(reinterpret_cast<void*>(virtPages), fileData + segment.offset, segment.fileSize);
+    }
+    memset(reinterpret_cast<void*>(virtPages + segment.fileSize), 0, pages * PAGE_SIZE - segment.fileSize);
+    
+    uint64_t flags = PTE_PRESENT | PTE_USER | PTE_OWNED;
+    if (segment.prot & PROT_WRITE) {
+        flags |= PTE_WRITABLE;
     }
     
+    proc->getVMM()->mapRange(reinterpret_cast<void*>(segment.start), physPages, pages, flags);
+    
+    return proc->addArea(segment.start, segment.end, segment.prot, VMAType::Image, pages);
+}
+
+void ELFLoader::setupEntry(Process* proc, uint64_t entry) {
     uint64_t userStack = proc->getUserStack();
     userStack &= ~0xFULL;
     
-    uint64_t entry = ehdr->e_entry;
     uint64_t trampolineAddr = reinterpret_cast<uint64_t>(&processTrampoline);
     
     uint64_t kernelStack = proc->getKernelStack();
@@ -115,10 +148,62 @@ Process* ELFLoader::loadELF(const void* data, size_t size) {
     proc->getContext()->rsp = kernelStack;
     proc->getContext()->rbp = 0;
     proc->getContext()->rflags = 0x202;
+}
+
+Process* ELFLoader::loadELF(const void* data, size_t size, bool persistent) {
+    ELFImage image;
+    if (!parse(data, size, &image)) {
+        return nullptr;
+    }
+    
+    uint32_t pid = Scheduler::get().allocatePID();
+    Process* proc = new Process(pid);
+    
+    const uint8_t* fileData = static_cast<const uint8_t*>(data);
+    
+    for (size_t i = 0; i < image.segmentCount; i++) {
+        if (!mapSegment(proc, image.segments[i], fileData, persistent)) {
+            delete proc;
+            return nullptr;
+        }
+    }
+    
+    setupEntry(proc, image.entry);
 
     return proc;
 }
 
+Process* ELFLoader::loadCachedImage(CachedImage* image) {
+    uint32_t pid = Scheduler::get().allocatePID();
+    Process* proc = new Process(pid);
+    
+    if (!image->text.mergeInto(*proc->getVMM())) {
+        delete proc;
+        return nullptr;
+    }
+    
+    for (size_t i = 0; i < image->elf.segmentCount; i++) {
+        const ELFSegment& segment = image->elf.segments[i];
+        
+        bool mapped = false;
+        if (!(segment.prot & PROT_WRITE)) {
+            mapped = proc->addArea(segment.start, segment.end, segment.prot, VMAType::Image, 0);
+        } else {
+            mapped = mapSegment(proc, segment, image->data, true);
+        }
+        
+        if (!mapped) {
+            delete proc;
+            return nullptr;
+        }
+    }
+    
+    proc->getVMAs()->addResident(image->textPages);
+    setupEntry(proc, image->elf.entry);
+    
+    return proc;
+}
+
 void ELFLoader::setupArguments(Process* proc, int argc, const char** argv) {
     if (!proc || argc < 0) return;
     
@@ -179,8 +264,18 @@ void ELFLoader::setupArguments(Process* proc, int argc, const char** argv) {
     *userRspOnStack = userStack;
 }
 
-Process* ELFLoader::loadELFWithArgs(const void* data, size_t size, int argc, const char** argv) {
-    Process* proc = loadELF(data, size);
+Process* ELFLoader::loadELFWithArgs(const void* data, size_t size, int argc, const char** argv, bool persistent) {
+    Process* proc = loadELF(data, size, persistent);
+    
+    if (proc) {
+        setupArguments(proc, argc, argv);
+    }
+    
+    return proc;
+}
+
+Process* ELFLoader::loadCachedImageWithArgs(CachedImage* image, int argc, const char** argv) {
+    Process* proc = loadCachedImage(image);
     
     if (proc) {
         setupArguments(proc, argc, argv);
@@ -63,17 +63,41 @@ struct Elf64_Phdr {
 #define PF_W          0x2
 #define PF_R          0x4
 
+constexpr size_t ELF_MAX_SEGMENTS = 16;
+
+// A PT_LOAD segment widened to page boundaries. offset is the file offset of
+// the byte backing start; everything past fileSize is zero filled.
+struct ELFSegment {
+    uint64_t start;
+    uint64_t end;
+    uint32_t prot;
+    uint64_t offset;
+    uint64_t fileSize;
+};
+
+struct ELFImage {
+    uint64_t entry;
+    ELFSegment segments[ELF_MAX_SEGMENTS];
+    size_t segmentCount;
+};
+
 class Process;
+struct CachedImage;
 
 class ELFLoader {
 public:
     static bool isValidELF(const void* data, size_t size);
-    static Process* loadELF(const void* data, size_t size);
-    static Process* loadELFWithArgs(const void* data, size_t size, int argc, const char** argv);
+    static bool parse(const void* data, size_t size, ELFImage* image);
+    static Process* loadELF(const void* data, size_t size, bool persistent = false);
+    static Process* loadELFWithArgs(const void* data, size_t size, int argc, const char** argv, bool persistent = false);
+    static Process* loadCachedImage(CachedImage* image);
+    static Process* loadCachedImageWithArgs(CachedImage* image, int argc, const char** argv);
     static Process* loadELFFromFile(const char* path);
     static Process* loadELFFromFileWithArgs(const char* path, int argc, const char** argv);
     
 private:
     static bool validateHeader(const Elf64_Ehdr* ehdr);
     static void setupArguments(Process* proc, int argc, const char** argv);
+    static void setupEntry(Process* proc, uint64_t entry);
+    static bool mapSegment(Process* proc, const ELFSegment& segment, const uint8_t* fileData, bool persistent);
 };
@@ -0,0 +1,155 @@
+#include "imagecache.hpp"
+#include <cpu/process/process.hpp>
+#include <cpu/mm/pmm.hpp>
+#include <x86_64/requests.hpp>
+#include <graphics/console.hpp>
+#include <string.h>
+
+extern Console* console;
+
+ImageCache imageCacheInstance;
+
+ImageCache& ImageCache::get() {
+    return imageCacheInstance;
+}
+
+CachedImage* ImageCache::lookup(VNode* node) {
+    if (!node || !node->ops || !node->ops->stat || !node->ops->map) return nullptr;
+
+    FileStats stats = {};
+    if (node->ops->stat(node, &stats) != 0) return nullptr;
+
+    for (size_t i = 0; i < count; i++) {
+        CachedImage* image = entries[i];
+        if (image->fs != node->getFS() || image->inode != node->getInode()) continue;
+
+        if (image->size == stats.size && image->mtime == stats.mtime) {
+            hits++;
+            image->lastUse = ++clock;
+            return image;
+        }
+
+        destroy(image);
+        entries[i] = entries[--count];
+        break;
+    }
+
+    misses++;
+
+    CachedImage* image = build(node, stats);
+    if (!image) return nullptr;
+
+    if (count == IMAGE_CACHE_CAPACITY) {
+        evict();
+    }
+
+    entries[count++] = image;
+    image->lastUse = ++clock;
+    return image;
+}
+
+CachedImage* ImageCache::build(VNode* node, const FileStats& stats) {
+    if (stats.size < sizeof(Elf64_Ehdr)) return nullptr;
+
+    uint64_t mappedSize = 0;
+    const uint8_t* data = static_cast<const uint8_t*>(node->ops->map(node, &mappedSize));
+    if (!data || mappedSize != stats.size) return nullptr;
+
+    CachedImage* image = new CachedImage();
+    image->fs = node->getFS();
+    image->inode = node->getInode();
+    image->size = stats.size;
+    image->mtime = stats.mtime;
+    image->data = data;
+    image->textPages = 0;
+    image->lastUse = 0;
+
+    if (!ELFLoader::parse(data, stats.size, &image->elf) || !buildTemplate(image)) {
+        destroy(image);
+        return nullptr;
+    }
+
+    return image;
+}
+
+static bool isWritablePage(const ELFImage& elf, uint64_t page) {
+    for (size_t i = 0; i < elf.segmentCount; i++) {
+        const ELFSegment& segment = elf.segments[i];
+        if ((segment.prot & PROT_WRITE) && page >= segment.start && page < segment.end) return true;
+    }
+    return false;
+}
+
+bool ImageCache::buildTemplate(CachedImage* image) {
+    image->text.init();
+    if (!image->text.isInitialized()) return false;
+
+    uint64_t hhdm = hhdm_request.response->offset;
+
+    for (size_t i = 0; i < image->elf.segmentCount; i++) {
+        const ELFSegment& segment = image->elf.segments[i];
+        if (segment.prot & PROT_WRITE) continue;
+
+        for (uint64_t page = segment.start; page < segment.end; page += PAGE_SIZE) {
+            // A page shared with a data segment is private to each process.
+            if (isWritablePage(image->elf, page)) continue;
+
+            uint64_t offset = page - segment.start;
+            uint64_t source = reinterpret_cast<uint64_t>(image->data) + segment.offset + offset;
+
+            if (offset + PAGE_SIZE <= segment.fileSize && !(source & (PAGE_SIZE - 1))) {
+                void* frame = reinterpret_cast<void*>(source - hhdm);
+                if (!image->text.map(reinterpret_cast<void*>(page), frame, PTE_PRESENT | PTE_USER)) return false;
+                continue;
+            }
+
+            void* frame = pmm.allocateZeroedPage();
+            if (!frame) return false;
+
+            if (offset < segment.fileSize) {
+                uint64_t length = segment.fileSize - offset;
+                if (length > PAGE_SIZE) length = PAGE_SIZE;
+
+                memcpy(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(frame) + hhdm),
+                       reinterpret_cast<const void*>(source), length);
+            }
+
+            if (!image->text.map(reinterpret_cast<void*>(page), frame, PTE_PRESENT | PTE_USER | PTE_OWNED)) {
+                pmm.freePage(frame);
+                return false;
+            }
+            image->textPages++;
+        }
+    }
+
+    return true;
+}
+
+void ImageCache::destroy(CachedImage* image) {
+    image->text.release();
+    delete image;
+}
+
+void ImageCache::evict() {
+    size_t oldest = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (entries[i]->lastUse < entries[oldest]->lastUse) {
+            oldest = i;
+        }
+    }
+
+    destroy(entries[oldest]);
+    entries[oldest] = entries[--count];
+}
+
+void ImageCache::dump() {
+    if (!console) return;
+
+    console->drawText("[EXEC] Image cache: ");
+    console->drawNumber(count);
+    console->drawText(" images, hits=");
+    console->drawNumber(hits);
+    console->drawText(" misses=");
+    console->drawNumber(misses);
+    console->drawText("\n");
+}
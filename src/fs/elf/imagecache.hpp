@@ -0,0 +1,53 @@
+#pragma once
+
+#include "elf.hpp"
+#include <cpu/mm/vmm.hpp>
+#include <fs/vfs/vfs.hpp>
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t IMAGE_CACHE_CAPACITY = 16;
+
+// A validated executable together with a template address space holding its
+// read-only segments. Frames owned by the template are shared into every
+// process through the PMM share counts, so evicting an image never pulls
+// pages out from under a running instance. Only files backed by memory that
+// never changes (VNodeOps::map) are cached, since other filesystems do not
+// track modification times.
+struct CachedImage {
+    FileSystem* fs;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime;
+    const uint8_t* data;
+    ELFImage elf;
+    VMM text;
+    size_t textPages;
+    uint64_t lastUse;
+};
+
+class ImageCache {
+public:
+    ImageCache() : count(0), clock(0), hits(0), misses(0) {}
+
+    static ImageCache& get();
+
+    CachedImage* lookup(VNode* node);
+    void dump();
+
+    size_t getCount() const { return count; }
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+
+private:
+    CachedImage* entries[IMAGE_CACHE_CAPACITY];
+    size_t count;
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t misses;
+
+    CachedImage* build(VNode* node, const FileStats& stats);
+    bool buildTemplate(CachedImage* image);
+    void destroy(CachedImage* image);
+    void evict();
+};
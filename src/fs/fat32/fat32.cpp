@@ -13,6 +13,7 @@ FAT32FS::FAT32FS(BlockDevice* device) : FileSystem("fat32"), device(device), roo
     ops.mkdir = nodeMkdir;
     ops.unlink = nodeUnlink;
     ops.rmdir = nodeRmdir;
+    ops.map = nullptr;
 }
 
 FAT32FS::~FAT32FS() {
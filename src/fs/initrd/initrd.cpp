@@ -22,6 +22,7 @@ InitrdFS::InitrdFS(void* data, size_t size) : FileSystem("initrd"), data(data),
     ops.mkdir = nullptr;
     ops.unlink = nullptr;
     ops.rmdir = nullptr;
+    ops.map = nodeMap;
 }
 
 InitrdFS::~InitrdFS() {
@@ -83,6 +84,22 @@ int64_t InitrdFS::nodeWrite(VNode* node, const void* buffer, uint64_t size, uint
     return -1;
 }
 
+const void* InitrdFS::nodeMap(VNode* node, uint64_t* size) {
+    if (!node || !size) return nullptr;
+    
+    InitrdFS* fs = static_cast<InitrdFS*>(node->getFS());
+    if (!fs || !fs->header) return nullptr;
+    
+    uint64_t inode = node->getInode();
+    if (inode == 0 || inode > fs->header->fileCount) return nullptr;
+    
+    InitrdFile* file = &fs->header->files[inode - 1];
+    if (file->offset > fs->dataSize || file->size > fs->dataSize - file->offset) return nullptr;
+    
+    *size = file->size;
+    return static_cast<uint8_t*>(fs->data) + file->offset;
+}
+
 int InitrdFS::nodeStat(VNode* node, FileStats* stats) {
     if (!node || !stats) return -1;
     
@@ -31,6 +31,7 @@ public:
     static int nodeStat(VNode* node, FileStats* stats);
     static int nodeReaddir(VNode* node, DirEntry* entries, uint64_t count, uint64_t* read);
     static VNode* nodeLookup(VNode* node, const char* name);
+    static const void* nodeMap(VNode* node, uint64_t* size);
     
 private:
     void* data;
@@ -1,5 +1,6 @@
 #include "ramfs.hpp"
 #include <cpu/mm/heap.hpp>
+#include <string.h>
 
 RamFS::RamFS() : FileSystem("ramfs"), rootNode(nullptr), rootData(nullptr), nextInode(1) {
     ops.open = nodeOpen;
@@ -13,6 +14,7 @@ RamFS::RamFS() : FileSystem("ramfs"), rootNode(nullptr), rootData(nullptr), next
     ops.mkdir = nodeMkdir;
     ops.unlink = nodeUnlink;
     ops.rmdir = nodeRmdir;
+    ops.map = nullptr;
 }
 
 RamFS::~RamFS() {
@@ -58,6 +60,7 @@ RamFSNode* RamFS::createNode(const char* name, FileType type, uint32_t mode) {
     node->inode = nextInode++;
     node->mode = mode;
     node->size = 0;
+    node->capacity = 0;
     node->data = nullptr;
     node->parent = nullptr;
     node->firstChild = nullptr;
@@ -125,28 +128,21 @@ int64_t RamFS::nodeWrite(VNode* node, const void* buffer, uint64_t size, uint64_
     if (!ramNode || ramNode->type != FileType::Regular) return -1;
     
     uint64_t newSize = offset + size;
-    if (newSize > ramNode->size) {
-        void* newData = kheap.allocate(newSize);
-        if (!newData) return -1;
+    if (newSize > ramNode->capacity) {
+        uint64_t capacity = ramNode->capacity * 2;
+        if (capacity < newSize) capacity = newSize;
         
-        if (ramNode->data) {
-            uint8_t* src = (uint8_t*)ramNode->data;
-            uint8_t* dst = (uint8_t*)newData;
-            for (uint64_t i = 0; i < ramNode->size; i++) {
-                dst[i] = src[i];
-            }
-            kheap.free(ramNode->data);
-        }
+        void* newData = kheap.reallocate(ramNode->data, capacity);
+        if (!newData) return -1;
         
         ramNode->data = newData;
+        ramNode->capacity = capacity;
+    }
+    if (newSize > ramNode->size) {
         ramNode->size = newSize;
     }
     
-    uint8_t* dst = (uint8_t*)ramNode->data + offset;
-    const uint8_t* src = (const uint8_t*)buffer;
-    for (uint64_t i = 0; i < size; i++) {
-        dst[i] = src[i];
-    }
+    memcpy((uint8_t*)ramNode->data + offset, buffer, size);
     
     return size;
 }
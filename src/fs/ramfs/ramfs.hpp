@@ -8,6 +8,7 @@ struct RamFSNode {
     uint64_t inode;
     uint32_t mode;
     uint64_t size;
+    uint64_t capacity;
     void* data;
     RamFSNode* parent;
     RamFSNode* firstChild;
@@ -1,8 +1,12 @@
 #include "vfs.hpp"
 #include <cpu/mm/heap.hpp>
+#include <cpu/mm/objcache.hpp>
 
 VFS vfsInstance;
 
+static ObjectCache<VNode> vnodeCache;
+static ObjectCache<FileDescriptor> fdCache;
+
 VFS& VFS::get() {
     return vfsInstance;
 }
@@ -21,6 +25,14 @@ VNode::VNode(FileSystem* fs, uint64_t inode, FileType type)
 VNode::~VNode() {
 }
 
+void* VNode::operator new(size_t) {
+    return vnodeCache.allocate();
+}
+
+void VNode::operator delete(void* ptr) {
+    vnodeCache.free(ptr);
+}
+
 FileSystem::FileSystem(const char* name) {
     for (int i = 0; i < 64 && name[i]; i++) {
         this->name[i] = name[i];
@@ -30,6 +42,14 @@ FileSystem::FileSystem(const char* name) {
 FileSystem::~FileSystem() {
 }
 
+void* FileDescriptor::operator new(size_t) {
+    return fdCache.allocate();
+}
+
+void FileDescriptor::operator delete(void* ptr) {
+    fdCache.free(ptr);
+}
+
 FileDescriptor::FileDescriptor(VNode* node, int flags) 
     : node(node), flags(flags), offset(0) {
     if (node) {
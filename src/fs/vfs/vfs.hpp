@@ -51,6 +51,7 @@ struct VNodeOps {
     int (*mkdir)(VNode* parent, const char* name, uint32_t mode, VNode** result);
     int (*unlink)(VNode* parent, const char* name);
     int (*rmdir)(VNode* parent, const char* name);
+    const void* (*map)(VNode* node, uint64_t* size);
 };
 
 class VNode {
@@ -58,6 +59,9 @@ public:
     VNode(FileSystem* fs, uint64_t inode, FileType type);
     ~VNode();
     
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    
     FileSystem* getFS() { return fs; }
     uint64_t getInode() { return inode; }
     FileType getType() { return type; }
@@ -94,6 +98,9 @@ public:
     FileDescriptor(VNode* node, int flags);
     ~FileDescriptor();
     
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    
     VNode* getNode() { return node; }
     int getFlags() { return flags; }
     uint64_t getOffset() { return offset; }
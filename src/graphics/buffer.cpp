@@ -1,4 +1,6 @@
 #include "buffer.hpp"
+#include <cpu/mm/vmm.hpp>
+#include <x86_64/requests.hpp>
 #include <string.h>
 
 Buffer::Buffer(limine_framebuffer* fb) {
@@ -12,6 +14,14 @@ Buffer::Buffer(limine_framebuffer* fb) {
     green_mask_shift = fb->green_mask_shift;
     blue_mask_size = fb->blue_mask_size;
     blue_mask_shift = fb->blue_mask_shift;
+
+    uint64_t virt = reinterpret_cast<uint64_t>(fb->address) & ~(PAGE_SIZE - 1);
+    uint64_t end = reinterpret_cast<uint64_t>(fb->address) + fb->pitch * fb->height;
+    size_t pages = (end - virt + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    vmm.mapRange(reinterpret_cast<void*>(virt),
+                 reinterpret_cast<void*>(virt - hhdm_request.response->offset),
+                 pages, PTE_PRESENT | PTE_WRITABLE | VMM::typeFlags(MemoryType::WriteCombining));
 }
 
 Buffer::~Buffer() {
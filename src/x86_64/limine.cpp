@@ -3,6 +3,7 @@
 #include <cpu/idt/idt.hpp>
 #include <cpu/syscall/syscall.hpp>
 #include <cpu/mm/memmgr.hpp>
+#include <cpu/mm/heapprof.hpp>
 #include <cpu/acpi/acpi.hpp>
 #include <cpu/apic/apic.hpp>
 #include <cpu/apic/irqs.hpp>
@@ -40,6 +41,10 @@ extern "C" void _kinit(){
 
     fb = new Framebuffer();
     console = new Console(fb);
+
+    console->drawText("PMM initialized in ");
+    console->drawNumber(mm.getPMMInitCycles());
+    console->drawText(" TSC cycles.\n");
         
     if (ACPI::get().initialize()) {
         console->drawText("ACPI initialized successfully.\n");
@@ -83,6 +88,10 @@ extern "C" void _kinit(){
     if (VFS::get().mount(ramfs, "/tmp") == 0) {
         console->drawText("RamFS mounted at /tmp\n");
     }
+
+#ifdef KHEAP_PROFILE
+    heapProfiler.dump(HEAP_PROFILE_DUMP_SITES);
+#endif
     
     int returnCode = main();
 
@@ -6,6 +6,7 @@
 #include <filesystem>
 
 constexpr uint32_t INITRD_MAGIC = 0x44524E49;
+constexpr uint64_t INITRD_FILE_ALIGN = 4096;
 
 struct InitrdFile {
     char name[64];
@@ -49,6 +50,8 @@ int main(int argc, char** argv) {
         std::vector<uint8_t> data(size);
         file.read(reinterpret_cast<char*>(data.data()), size);
         
+        currentOffset = (currentOffset + INITRD_FILE_ALIGN - 1) & ~(INITRD_FILE_ALIGN - 1);
+        
         InitrdFile fileEntry;
         std::memset(&fileEntry, 0, sizeof(fileEntry));
         
@@ -82,8 +85,12 @@ int main(int argc, char** argv) {
         output.write(reinterpret_cast<const char*>(&file), sizeof(file));
     }
     
-    for (const auto& data : fileData) {
-        output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    uint64_t written = sizeof(header) + files.size() * sizeof(InitrdFile);
+    for (size_t i = 0; i < fileData.size(); i++) {
+        std::vector<char> padding(files[i].offset - written, 0);
+        output.write(padding.data(), padding.size());
+        output.write(reinterpret_cast<const char*>(fileData[i].data()), fileData[i].size());
+        written = files[i].offset + fileData[i].size();
     }
     
     std::cout << "Created initrd: " << outputPath << std::endl;